@@ -4,7 +4,12 @@
 #include "devices/kbd.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
+#include "threads/fpu.h"
 #include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
@@ -122,6 +127,14 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  fpu_print_stats ();
+  palloc_print_stats ();
+  kmem_cache_print_stats ();
+  malloc_print_stats ();
+  adaptive_lock_print_stats ();
+#ifdef LOCK_PROFILE
+  lock_print_stats ();
+#endif
 #ifdef FILESYS
   block_print_stats ();
 #endif
@@ -18,8 +18,10 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
-/* Number of timer ticks since OS booted. */
+/* Number of timer ticks since OS booted.
+   Written only by the timer interrupt, under ticks_seq. */
 static int64_t ticks;
+static struct seqlock ticks_seq;
 
 struct list sleep_list;
 
@@ -41,6 +43,7 @@ timer_init (void)
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
   list_init (&sleep_list);
+  seqlock_init (&ticks_seq);
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -74,9 +77,18 @@ timer_calibrate (void)
 int64_t
 timer_ticks (void) 
 {
-  enum intr_level old_level = intr_disable ();
-  int64_t t = ticks;
-  intr_set_level (old_level);
+  unsigned seq;
+  int64_t t;
+
+  /* A 64-bit load is two instructions, so a tick could land in
+     between; retry in that case instead of disabling
+     interrupts. */
+  do
+    {
+      seq = seqlock_read_begin (&ticks_seq);
+      t = ticks;
+    }
+  while (seqlock_read_retry (&ticks_seq, seq));
   return t;
 }
 
@@ -190,7 +202,9 @@ timer_interrupt (struct intr_frame *args UNUSED)
 	struct list_elem *head;
 	struct thread *hthread;
 
+  seqlock_write_begin (&ticks_seq);
   ticks++;
+  seqlock_write_end (&ticks_seq);
   thread_tick ();
 
 
@@ -0,0 +1,53 @@
+/* syscall-bench.c
+
+   Measures the round-trip cost of a system call that does no
+   work, filesize() on a file descriptor that is not open, first
+   through `int $0x30' and then through SYSENTER/SYSEXIT if the
+   CPU supports it.  Prints the average in CPU cycles. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <syscall.h>
+
+/* Number of calls timed on each path. */
+#define CALL_CNT 100000
+
+static uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns the average cycles per null system call. */
+static uint64_t
+time_null_syscall (void)
+{
+  uint64_t start;
+  int i;
+
+  start = rdtsc ();
+  for (i = 0; i < CALL_CNT; i++)
+    filesize (-1);
+  return (rdtsc () - start) / CALL_CNT;
+}
+
+int
+main (void)
+{
+  bool have_sysenter = syscall_sysenter;
+
+  syscall_sysenter = false;
+  printf ("int $0x30: %"PRIu64" cycles per call\n", time_null_syscall ());
+
+  if (have_sysenter)
+    {
+      syscall_sysenter = true;
+      printf ("sysenter:  %"PRIu64" cycles per call\n", time_null_syscall ());
+    }
+  else
+    printf ("sysenter:  not supported by this CPU\n");
+
+  return EXIT_SUCCESS;
+}
@@ -6,6 +6,8 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -54,14 +56,42 @@ byte_to_sector (const struct inode *inode, off_t pos)
 }
 
 /* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
+   returns the same `struct inode'.  Lookups hold open_inodes_lock
+   for reading; adding or removing an inode holds it for
+   writing. */
 static struct list open_inodes;
+static struct rwlock open_inodes_lock;
+
+/* Cache of struct inode. */
+static struct kmem_cache *inode_cache;
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  rwlock_init (&open_inodes_lock);
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode), NULL);
+  if (inode_cache == NULL)
+    PANIC ("inode_init: out of memory");
+}
+
+/* Returns the open inode for SECTOR, reopened, or a null
+   pointer if SECTOR is not open.  OPEN_INODES_LOCK must be
+   held. */
+static struct inode *
+find_open_inode (block_sector_t sector)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+       e = list_next (e)) 
+    {
+      struct inode *inode = list_entry (e, struct inode, elem);
+      if (inode->sector == sector) 
+        return inode_reopen (inode);
+    }
+  return NULL;
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -111,33 +141,39 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
-  struct inode *inode;
+  struct inode *inode, *open;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
-    {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
-    }
+  rwlock_acquire_read (&open_inodes_lock);
+  inode = find_open_inode (sector);
+  rwlock_release_read (&open_inodes_lock);
+  if (inode != NULL)
+    return inode;
 
-  /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  /* Allocate memory and read the inode without holding the
+     lock, so that a disk read doesn't stall every other open and
+     close. */
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
     return NULL;
-
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
   block_read (fs_device, inode->sector, &inode->data);
+
+  /* Check again now that we're the only one who can add it.  If
+     someone else opened it meanwhile, use theirs. */
+  rwlock_acquire_write (&open_inodes_lock);
+  open = find_open_inode (sector);
+  if (open == NULL)
+    list_push_front (&open_inodes, &inode->elem);
+  rwlock_release_write (&open_inodes_lock);
+  if (open != NULL)
+    {
+      kmem_cache_free (inode_cache, inode);
+      return open;
+    }
   return inode;
 }
 
@@ -145,8 +181,12 @@ inode_open (block_sector_t sector)
 struct inode *
 inode_reopen (struct inode *inode)
 {
+  /* Several readers of open_inodes may reopen the same inode at
+     once, so the increment must be a single instruction, which
+     is atomic on a uniprocessor.  See the description of the INC
+     instruction in [IA32-v2a]. */
   if (inode != NULL)
-    inode->open_cnt++;
+    asm ("incl %0" : "+m" (inode->open_cnt) : : "cc");
   return inode;
 }
 
@@ -163,15 +203,25 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode) 
 {
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  /* Release resources if this was the last opener.  The
+     decrement must be a single instruction, like the increment in
+     inode_reopen(), which file_reopen() calls without holding
+     open_inodes_lock.  A caller that reopens holds a reference of
+     its own, so the count can't reach zero under it. */
+  rwlock_acquire_write (&open_inodes_lock);
+  asm ("decl %0; sete %1"
+       : "+m" (inode->open_cnt), "=qm" (last) : : "cc");
+  if (last)
     {
       /* Remove from inode list and release lock. */
       list_remove (&inode->elem);
+      rwlock_release_write (&open_inodes_lock);
  
       /* Deallocate blocks if removed. */
       if (inode->removed) 
@@ -181,8 +231,10 @@ inode_close (struct inode *inode)
                             bytes_to_sectors (inode->data.length)); 
         }
 
-      free (inode); 
+      kmem_cache_free (inode_cache, inode);
     }
+  else
+    rwlock_release_write (&open_inodes_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -0,0 +1,19 @@
+#ifndef __LIB_IOVEC_H
+#define __LIB_IOVEC_H
+
+/* Scatter/gather I/O vectors, as used by the readv and writev
+   system calls.  Shared between the kernel and user programs. */
+
+#include <stddef.h>
+
+/* One buffer of a vector. */
+struct iovec
+  {
+    void *iov_base;             /* Start of buffer. */
+    size_t iov_len;             /* Length of buffer in bytes. */
+  };
+
+/* Maximum number of buffers in one vector. */
+#define IOV_MAX 64
+
+#endif /* lib/iovec.h */
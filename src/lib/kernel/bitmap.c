@@ -3,6 +3,7 @@
 #include <limits.h>
 #include <round.h>
 #include <stdio.h>
+#include <string.h>
 #include "threads/malloc.h"
 #ifdef FILESYS
 #include "filesys/file.h"
@@ -23,11 +24,24 @@ typedef unsigned long elem_type;
 
 /* From the outside, a bitmap is an array of bits.  From the
    inside, it's an array of elem_type (defined above) that
-   simulates an array of bits. */
+   simulates an array of bits.
+
+   A bitmap created with bitmap_create_two_level() also has a
+   second, much smaller array of bits with one bit per element
+   of BITS, which is set if and only if every bit in that
+   element is true.  Searches for false bits consult it to skip
+   over full elements 32 at a time, so that finding a free bit
+   in a nearly full map touches only a few cache lines.
+
+   Every bitmap also has a roving cursor, used by
+   bitmap_scan_and_flip_next() to resume searching where the
+   previous search left off. */
 struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
     elem_type *bits;    /* Elements that represent bits. */
+    elem_type *full;    /* One bit per full element, or null. */
+    size_t cursor;      /* Where the next next-fit search starts. */
   };
 
 /* Returns the index of the element that contains the bit
@@ -69,6 +83,124 @@ last_mask (const struct bitmap *b)
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns an elem_type with bits LO...HI-1 set, where
+   0 <= LO < HI <= ELEM_BITS. */
+static inline elem_type
+range_mask (size_t lo, size_t hi)
+{
+  elem_type high = hi < ELEM_BITS ? ((elem_type) 1 << hi) - 1 : (elem_type) -1;
+  return high & ~(((elem_type) 1 << lo) - 1);
+}
+
+/* Returns the index of the least significant set bit in
+   nonzero W. */
+static inline size_t
+first_set (elem_type w)
+{
+  /* See [IA32-v2a] "BSF". */
+  elem_type idx;
+  asm ("bsfl %1, %0" : "=r" (idx) : "rm" (w) : "cc");
+  return idx;
+}
+
+/* Returns the number of set bits in W. */
+static inline size_t
+popcount (elem_type w)
+{
+  w = w - ((w >> 1) & 0x55555555);
+  w = (w & 0x33333333) + ((w >> 2) & 0x33333333);
+  w = (w + (w >> 4)) & 0x0f0f0f0f;
+  return (w * 0x01010101) >> 24;
+}
+
+/* Returns the bits of element IDX of B that are in use: all of
+   them, except in the last element. */
+static inline elem_type
+used_bits (const struct bitmap *b, size_t idx)
+{
+  return idx == elem_cnt (b->bit_cnt) - 1 ? last_mask (b) : (elem_type) -1;
+}
+
+/* Brings the summary bit for element IDX of B up to date, if B
+   has a summary. */
+static inline void
+update_summary (struct bitmap *b, size_t idx)
+{
+  if (b->full != NULL)
+    {
+      elem_type mask = bit_mask (idx);
+      if (b->bits[idx] == used_bits (b, idx))
+        b->full[elem_idx (idx)] |= mask;
+      else
+        b->full[elem_idx (idx)] &= ~mask;
+    }
+}
+
+/* Returns the index of the first element at or after IDX in B
+   that is not full, according to B's summary, or the number of
+   elements in B if there is none. */
+static size_t
+next_nonfull (const struct bitmap *b, size_t idx)
+{
+  size_t elem_total = elem_cnt (b->bit_cnt);
+  size_t sidx, slast;
+  elem_type w;
+
+  if (idx >= elem_total)
+    return elem_total;
+
+  sidx = elem_idx (idx);
+  slast = elem_cnt (elem_total) - 1;
+  w = ~b->full[sidx] & ~(bit_mask (idx) - 1);
+  while (w == 0)
+    {
+      if (sidx == slast)
+        return elem_total;
+      w = ~b->full[++sidx];
+    }
+  idx = sidx * ELEM_BITS + first_set (w);
+  return idx < elem_total ? idx : elem_total;
+}
+
+/* Returns the index of the first bit at or after START in B
+   that is set to VALUE, or B's size if there is none.
+
+   This is the workhorse of the multiple-bit operations below:
+   rather than testing one bit at a time, it skips whole
+   elements in which every bit is !VALUE and then uses BSF to
+   find the bit within the element.  When looking for a false
+   bit in a bitmap with a summary, the summary is used to skip
+   over full elements. */
+static size_t
+find_bit (const struct bitmap *b, size_t start, bool value) 
+{
+  elem_type flip = value ? 0 : (elem_type) -1;
+  bool use_summary = !value && b->full != NULL;
+  size_t idx, last, bit;
+  elem_type w;
+
+  if (start >= b->bit_cnt)
+    return b->bit_cnt;
+
+  idx = elem_idx (start);
+  last = elem_cnt (b->bit_cnt) - 1;
+  w = (b->bits[idx] ^ flip) & ~(bit_mask (start) - 1);
+  while (w == 0)
+    {
+      if (idx == last)
+        return b->bit_cnt;
+      idx = use_summary ? next_nonfull (b, idx + 1) : idx + 1;
+      if (idx > last)
+        return b->bit_cnt;
+      w = b->bits[idx] ^ flip;
+    }
+
+  /* Unused bits at the end of the last element are always
+     false, so searching for false may find one of them. */
+  bit = idx * ELEM_BITS + first_set (w);
+  return bit < b->bit_cnt ? bit : b->bit_cnt;
+}
+
 /* Creation and destruction. */
 
 /* Initializes B to be a bitmap of BIT_CNT bits
@@ -82,6 +214,8 @@ bitmap_create (size_t bit_cnt)
   if (b != NULL)
     {
       b->bit_cnt = bit_cnt;
+      b->full = NULL;
+      b->cursor = 0;
       b->bits = malloc (byte_cnt (bit_cnt));
       if (b->bits != NULL || bit_cnt == 0)
         {
@@ -93,6 +227,30 @@ bitmap_create (size_t bit_cnt)
   return NULL;
 }
 
+/* Creates and returns a bitmap of BIT_CNT bits, all set to
+   false, that also keeps a summary of which of its elements are
+   full, making searches for false bits fast even when nearly
+   every bit is true.  Modifying such a bitmap updates both
+   levels, so unlike other bitmaps, modifications are not atomic
+   and callers must serialize them.
+   Returns a null pointer if memory allocation failed. */
+struct bitmap *
+bitmap_create_two_level (size_t bit_cnt) 
+{
+  struct bitmap *b = bitmap_create (bit_cnt);
+  if (b != NULL && bit_cnt > 0)
+    {
+      b->full = malloc (byte_cnt (elem_cnt (bit_cnt)));
+      if (b->full == NULL)
+        {
+          bitmap_destroy (b);
+          return NULL;
+        }
+      memset (b->full, 0, byte_cnt (elem_cnt (bit_cnt)));
+    }
+  return b;
+}
+
 /* Creates and returns a bitmap with BIT_CNT bits in the
    BLOCK_SIZE bytes of storage preallocated at BLOCK.
    BLOCK_SIZE must be at least bitmap_needed_bytes(BIT_CNT). */
@@ -105,6 +263,8 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
 
   b->bit_cnt = bit_cnt;
   b->bits = (elem_type *) (b + 1);
+  b->full = NULL;
+  b->cursor = 0;
   bitmap_set_all (b, false);
   return b;
 }
@@ -125,6 +285,7 @@ bitmap_destroy (struct bitmap *b)
 {
   if (b != NULL) 
     {
+      free (b->full);
       free (b->bits);
       free (b);
     }
@@ -164,6 +325,7 @@ bitmap_mark (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the OR instruction in [IA32-v2b]. */
   asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  update_summary (b, idx);
 }
 
 /* Atomically sets the bit numbered BIT_IDX in B to false. */
@@ -177,6 +339,7 @@ bitmap_reset (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the AND instruction in [IA32-v2a]. */
   asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  update_summary (b, idx);
 }
 
 /* Atomically toggles the bit numbered IDX in B;
@@ -192,6 +355,7 @@ bitmap_flip (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the XOR instruction in [IA32-v2b]. */
   asm ("xorl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  update_summary (b, idx);
 }
 
 /* Returns the value of the bit numbered IDX in B. */
@@ -214,18 +378,35 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Each element is updated atomically, but the operation as a
+   whole is not atomic. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
+  size_t end = start + cnt;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  while (start < end)
+    {
+      size_t idx = elem_idx (start);
+      size_t lo = start % ELEM_BITS;
+      size_t hi = end - idx * ELEM_BITS < ELEM_BITS
+                  ? end - idx * ELEM_BITS : ELEM_BITS;
+      elem_type mask = range_mask (lo, hi);
+
+      /* Atomic for the same reason as in bitmap_mark() and
+         bitmap_reset(). */
+      if (value)
+        asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+      else
+        asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+      update_summary (b, idx);
+      start = (idx + 1) * ELEM_BITS;
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -233,17 +414,23 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t end = start + cnt;
+  size_t true_cnt = 0;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
-  return value_cnt;
+  while (start < end)
+    {
+      size_t idx = elem_idx (start);
+      size_t lo = start % ELEM_BITS;
+      size_t hi = end - idx * ELEM_BITS < ELEM_BITS
+                  ? end - idx * ELEM_BITS : ELEM_BITS;
+      true_cnt += popcount (b->bits[idx] & range_mask (lo, hi));
+      start = (idx + 1) * ELEM_BITS;
+    }
+  return value ? true_cnt : cnt - true_cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -251,16 +438,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return cnt > 0 && find_bit (b, start, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -292,7 +474,11 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
-   If there is no such group, returns BITMAP_ERROR. */
+   If there is no such group, returns BITMAP_ERROR.
+
+   Alternates between finding the next bit set to VALUE, which
+   starts a run, and the next bit set to !VALUE, which ends it,
+   so each element of B is examined at most about twice. */
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
@@ -302,10 +488,22 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   if (cnt <= b->bit_cnt) 
     {
       size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      size_t i = start;
+
+      if (cnt == 0)
+        return i;
+      while (i <= last)
+        {
+          size_t end;
+
+          i = find_bit (b, i, value);
+          if (i > last)
+            break;
+          end = find_bit (b, i + 1, !value);
+          if (end - i >= cnt)
+            return i;
+          i = end;
+        }
     }
   return BITMAP_ERROR;
 }
@@ -325,6 +523,35 @@ bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value)
     bitmap_set_multiple (b, idx, cnt, !value);
   return idx;
 }
+
+/* Like bitmap_scan_and_flip(), but "next fit": the search
+   starts where the previous call to this function on B left
+   off, wrapping around to the beginning of B if necessary,
+   instead of always starting from the beginning.  This avoids
+   rescanning the allocated region at the start of a nearly full
+   bitmap on every call. */
+size_t
+bitmap_scan_and_flip_next (struct bitmap *b, size_t cnt, bool value)
+{
+  size_t start = b->cursor < b->bit_cnt ? b->cursor : 0;
+  size_t idx = bitmap_scan (b, start, cnt, value);
+
+  /* Wrap around.  A group that straddles START is found here,
+     too. */
+  if (idx == BITMAP_ERROR && start > 0)
+    {
+      idx = bitmap_scan (b, 0, cnt, value);
+      if (idx != BITMAP_ERROR && idx >= start)
+        idx = BITMAP_ERROR;
+    }
+
+  if (idx != BITMAP_ERROR)
+    {
+      bitmap_set_multiple (b, idx, cnt, !value);
+      b->cursor = idx + cnt;
+    }
+  return idx;
+}
 
 /* File input and output. */
 
@@ -336,6 +563,17 @@ bitmap_file_size (const struct bitmap *b)
   return byte_cnt (b->bit_cnt);
 }
 
+/* Rebuilds B's summary, if it has one, from scratch. */
+static void
+rebuild_summary (struct bitmap *b)
+{
+  size_t idx;
+
+  if (b->full != NULL)
+    for (idx = 0; idx < elem_cnt (b->bit_cnt); idx++)
+      update_summary (b, idx);
+}
+
 /* Reads B from FILE.  Returns true if successful, false
    otherwise. */
 bool
@@ -347,6 +585,7 @@ bitmap_read (struct bitmap *b, struct file *file)
       off_t size = byte_cnt (b->bit_cnt);
       success = file_read_at (file, b->bits, size, 0) == size;
       b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
+      rebuild_summary (b);
     }
   return success;
 }
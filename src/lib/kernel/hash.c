@@ -8,6 +8,7 @@
 #include "hash.h"
 #include "../debug.h"
 #include "threads/malloc.h"
+#include "threads/vaddr.h"
 
 #define list_elem_to_hash_elem(LIST_ELEM)                       \
         list_entry(LIST_ELEM, struct hash_elem, list_elem)
@@ -278,27 +279,122 @@ hash_bytes (const void *buf_, size_t size)
   return hash;
 } 
 
+/* 2**32 divided by the golden ratio, rounded to odd.  Multiplying
+   by this spreads consecutive keys as far apart as possible
+   ("Fibonacci hashing"; see Knuth, volume 3, section 6.4). */
+#define GOLDEN_32 0x9e3779b9u
+
+/* Returns a Fibonacci hash of X.
+
+   Takes the full 64-bit product of X and GOLDEN_32 and adds its
+   two halves.  The high half spreads consecutive and evenly
+   strided keys almost perfectly evenly over its low bits, which
+   are the ones hash tables use to pick a bucket.  The low half
+   of the product alone would not: its low bits repeat with any
+   power-of-2 stride in the keys.  The low half's top bits, which
+   ohash.c keeps in its control bytes, are the classic Fibonacci
+   hash.  On i386 this is a single MUL and an ADD. */
+static inline unsigned
+fib_hash (uint32_t x)
+{
+  uint64_t p = (uint64_t) x * GOLDEN_32;
+  return (uint32_t) p + (uint32_t) (p >> 32);
+}
+
+/* Mixes word W into HASH, for hashing strings a word at a
+   time. */
+static inline uint32_t
+mix_word (uint32_t hash, uint32_t w)
+{
+  return (((hash << 5) | (hash >> 27)) ^ w) * GOLDEN_32;
+}
+
+/* Returns a word with the top bit set in each byte of W that is
+   zero.  Bytes above a zero byte may also be flagged, but the
+   lowest flagged byte is always zero. */
+static inline uint32_t
+zero_bytes (uint32_t w)
+{
+  return (w - 0x01010101u) & ~w & 0x80808080u;
+}
+
 /* Returns a hash of string S. */
 unsigned
-hash_string (const char *s_) 
+hash_string (const char *s) 
 {
-  const unsigned char *s = (const unsigned char *) s_;
-  unsigned hash;
+  return hash_string_seeded (s, 0);
+}
+
+/* Returns a hash of string S that also depends on SEED.  Tables
+   whose keys may be chosen by users can pick a random seed so
+   that the keys that collide can't be predicted.
+
+   S is read an aligned 32-bit word at a time, and the bytes of
+   each 4-byte chunk of S are assembled from at most two aligned
+   words, so that the hash does not depend on S's alignment.  An
+   aligned word that contains any byte of S, or its terminator,
+   lies in the same page as that byte, so reading it is safe. */
+unsigned
+hash_string_seeded (const char *s, unsigned seed) 
+{
+  unsigned shift = ((uintptr_t) s & 3) * 8;
+  const uint32_t *p = (const uint32_t *) ((uintptr_t) s & ~(uintptr_t) 3);
+  uint32_t hash = seed;
+  uint32_t cur, chunk, z;
 
   ASSERT (s != NULL);
 
-  hash = FNV_32_BASIS;
-  while (*s != '\0')
-    hash = (hash * FNV_32_PRIME) ^ *s++;
+  cur = *p++;
+  for (;;)
+    {
+      if (shift == 0)
+        {
+          chunk = cur;
+          cur = *p++;
+        }
+      else
+        {
+          /* The chunk's low bytes are the high bytes of CUR.  Its
+             high bytes come from the next word, unless the string
+             ends first. */
+          chunk = cur >> shift;
+          if (zero_bytes (chunk | (0xffffffffu << (32 - shift))) == 0)
+            {
+              cur = *p++;
+              chunk |= cur << (32 - shift);
+            }
+        }
 
-  return hash;
+      z = zero_bytes (chunk);
+      if (z != 0)
+        {
+          /* Keep only the bytes before the terminator.  The
+             lowest bit set in Z is bit 7 of the terminator. */
+          chunk &= ((z & -z) >> 7) - 1;
+          hash = mix_word (hash, chunk);
+          break;
+        }
+      hash = mix_word (hash, chunk);
+    }
+
+  return hash ^ (hash >> 16);
 }
 
 /* Returns a hash of integer I. */
 unsigned
 hash_int (int i) 
 {
-  return hash_bytes (&i, sizeof i);
+  return fib_hash (i);
+}
+
+/* Returns a hash of page-aligned address PAGE.  The low PGBITS
+   bits, which are always zero for such addresses, are shifted
+   out first so that every bit of the multiplier's input
+   counts. */
+unsigned
+hash_page (const void *page) 
+{
+  return fib_hash ((uintptr_t) page >> PGBITS);
 }
 
 /* Returns the bucket in H that E belongs in. */
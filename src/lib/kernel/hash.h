@@ -98,6 +98,8 @@ bool hash_empty (struct hash *);
 /* Sample hash functions. */
 unsigned hash_bytes (const void *, size_t);
 unsigned hash_string (const char *);
+unsigned hash_string_seeded (const char *, unsigned seed);
 unsigned hash_int (int);
+unsigned hash_page (const void *);
 
 #endif /* lib/kernel/hash.h */
@@ -0,0 +1,557 @@
+/* Open-addressing hash table.
+
+   See ohash.h for basic information. */
+
+#include "ohash.h"
+#include <string.h>
+#include "../debug.h"
+#include "threads/malloc.h"
+
+/* Control bytes.  A full slot's control byte is the top 7 bits
+   of its element's hash value, so it is always less than
+   CTRL_EMPTY; empty and deleted slots have the top bit set. */
+#define CTRL_EMPTY   0x80       /* Never used since last cleared. */
+#define CTRL_DELETED 0xfe       /* Used, then deleted. */
+
+/* Slots are probed in groups of GROUP_SIZE, whose control bytes
+   are read as a single 32-bit word. */
+#define GROUP_SIZE 4
+
+/* Minimum number of slots in a table. */
+#define MIN_SLOTS 16
+
+/* Minimum number of slots moved from the old table to the new
+   one on each insertion or deletion during a resize. */
+#define MOVE_SLOTS 16
+
+/* Every byte of a group word set to 1 or 0x80, respectively. */
+#define ONES  0x01010101u
+#define HIGHS 0x80808080u
+
+static size_t find_elem (struct ohash *, struct ohash_elem *,
+                         struct ohash_table **);
+static void make_room (struct ohash *);
+static void move_some (struct ohash *);
+static bool start_resize (struct ohash *, size_t elem_cnt);
+static bool table_init (struct ohash_table *, size_t slot_cnt);
+static void table_free (struct ohash_table *);
+static void table_put (struct ohash_table *, struct ohash_elem *);
+static void table_remove (struct ohash_table *, size_t idx);
+
+/* Initializes hash table H to compute hash values using HASH and
+   compare hash elements using LESS, given auxiliary data AUX. */
+bool
+ohash_init (struct ohash *h,
+            ohash_hash_func *hash, ohash_less_func *less, void *aux)
+{
+  h->elem_cnt = 0;
+  h->old.slot_cnt = 0;
+  h->old.used_cnt = 0;
+  h->old.ctrl = NULL;
+  h->old.slots = NULL;
+  h->move_idx = 0;
+  h->hash = hash;
+  h->less = less;
+  h->aux = aux;
+  return table_init (&h->cur, MIN_SLOTS);
+}
+
+/* Removes all the elements from H.
+
+   If DESTRUCTOR is non-null, then it is called for each element
+   in the hash.  DESTRUCTOR may, if appropriate, deallocate the
+   memory used by the hash element.  However, modifying hash
+   table H while ohash_clear() is running, using any of the
+   functions ohash_clear(), ohash_destroy(), ohash_insert(),
+   ohash_replace(), or ohash_delete(), yields undefined
+   behavior, whether done in DESTRUCTOR or elsewhere. */
+void
+ohash_clear (struct ohash *h, ohash_action_func *destructor)
+{
+  if (destructor != NULL)
+    ohash_apply (h, destructor);
+
+  table_free (&h->old);
+  memset (h->cur.ctrl, CTRL_EMPTY, h->cur.slot_cnt);
+  h->cur.used_cnt = 0;
+  h->elem_cnt = 0;
+}
+
+/* Destroys hash table H.
+
+   If DESTRUCTOR is non-null, then it is first called for each
+   element in the hash.  DESTRUCTOR may, if appropriate,
+   deallocate the memory used by the hash element.  However,
+   modifying hash table H while ohash_clear() is running, using
+   any of the functions ohash_clear(), ohash_destroy(),
+   ohash_insert(), ohash_replace(), or ohash_delete(), yields
+   undefined behavior, whether done in DESTRUCTOR or
+   elsewhere. */
+void
+ohash_destroy (struct ohash *h, ohash_action_func *destructor)
+{
+  if (destructor != NULL)
+    ohash_clear (h, destructor);
+  table_free (&h->old);
+  table_free (&h->cur);
+}
+
+/* Inserts NEW into hash table H and returns a null pointer, if
+   no equal element is already in the table.
+   If an equal element is already in the table, returns it
+   without inserting NEW. */
+struct ohash_elem *
+ohash_insert (struct ohash *h, struct ohash_elem *new)
+{
+  struct ohash_table *t;
+  size_t idx = find_elem (h, new, &t);
+
+  if (t != NULL)
+    return t->slots[idx];
+
+  make_room (h);
+  table_put (&h->cur, new);
+  h->elem_cnt++;
+  move_some (h);
+  return NULL;
+}
+
+/* Inserts NEW into hash table H, replacing any equal element
+   already in the table, which is returned. */
+struct ohash_elem *
+ohash_replace (struct ohash *h, struct ohash_elem *new)
+{
+  struct ohash_table *t;
+  size_t idx = find_elem (h, new, &t);
+  struct ohash_elem *old;
+
+  if (t == NULL)
+    return ohash_insert (h, new);
+
+  /* NEW has the same hash value as OLD, so it can take over
+     OLD's slot and control byte. */
+  old = t->slots[idx];
+  t->slots[idx] = new;
+  return old;
+}
+
+/* Finds and returns an element equal to E in hash table H, or a
+   null pointer if no equal element exists in the table. */
+struct ohash_elem *
+ohash_find (struct ohash *h, struct ohash_elem *e)
+{
+  struct ohash_table *t;
+  size_t idx = find_elem (h, e, &t);
+
+  return t != NULL ? t->slots[idx] : NULL;
+}
+
+/* Finds, removes, and returns an element equal to E in hash
+   table H.  Returns a null pointer if no equal element existed
+   in the table.
+
+   If the elements of the hash table are dynamically allocated,
+   or own resources that are, then it is the caller's
+   responsibility to deallocate them. */
+struct ohash_elem *
+ohash_delete (struct ohash *h, struct ohash_elem *e)
+{
+  struct ohash_table *t;
+  size_t idx = find_elem (h, e, &t);
+  struct ohash_elem *found;
+
+  if (t == NULL)
+    return NULL;
+
+  found = t->slots[idx];
+  table_remove (t, idx);
+  h->elem_cnt--;
+  move_some (h);
+
+  /* Shrink the table if it has become mostly empty.  If the
+     allocation fails, the table is just bigger than it needs
+     to be. */
+  if (h->old.slot_cnt == 0 && h->cur.slot_cnt > MIN_SLOTS
+      && h->elem_cnt < h->cur.slot_cnt / 8)
+    start_resize (h, h->elem_cnt);
+
+  return found;
+}
+
+/* Calls ACTION for each element in hash table H in arbitrary
+   order.
+   Modifying hash table H while ohash_apply() is running, using
+   any of the functions ohash_clear(), ohash_destroy(),
+   ohash_insert(), ohash_replace(), or ohash_delete(), yields
+   undefined behavior, whether done from ACTION or elsewhere. */
+void
+ohash_apply (struct ohash *h, ohash_action_func *action)
+{
+  struct ohash_iterator i;
+
+  ASSERT (action != NULL);
+
+  ohash_first (&i, h);
+  while (ohash_next (&i))
+    action (ohash_cur (&i), h->aux);
+}
+
+/* Initializes I for iterating hash table H.
+
+   Iteration idiom:
+
+      struct ohash_iterator i;
+
+      ohash_first (&i, h);
+      while (ohash_next (&i))
+        {
+          struct foo *f = ohash_entry (ohash_cur (&i), struct foo, elem);
+          ...do something with f...
+        }
+
+   Modifying hash table H during iteration, using any of the
+   functions ohash_clear(), ohash_destroy(), ohash_insert(),
+   ohash_replace(), or ohash_delete(), invalidates all
+   iterators. */
+void
+ohash_first (struct ohash_iterator *i, struct ohash *h)
+{
+  ASSERT (i != NULL);
+  ASSERT (h != NULL);
+
+  i->hash = h;
+  i->table = &h->old;
+  i->idx = (size_t) -1;
+  i->elem = NULL;
+}
+
+/* Advances I to the next element in the hash table and returns
+   it.  Returns a null pointer if no elements are left.  Elements
+   are returned in arbitrary order.
+
+   Modifying a hash table H during iteration, using any of the
+   functions ohash_clear(), ohash_destroy(), ohash_insert(),
+   ohash_replace(), or ohash_delete(), invalidates all
+   iterators. */
+struct ohash_elem *
+ohash_next (struct ohash_iterator *i)
+{
+  ASSERT (i != NULL);
+
+  for (;;)
+    {
+      if (++i->idx < i->table->slot_cnt)
+        {
+          if (i->table->ctrl[i->idx] < CTRL_EMPTY)
+            return i->elem = i->table->slots[i->idx];
+        }
+      else if (i->table == &i->hash->old)
+        {
+          i->table = &i->hash->cur;
+          i->idx = (size_t) -1;
+        }
+      else
+        {
+          i->idx = i->table->slot_cnt;
+          return i->elem = NULL;
+        }
+    }
+}
+
+/* Returns the current element in the hash table iteration, or a
+   null pointer at the end of the table.  Undefined behavior
+   after calling ohash_first() but before ohash_next(). */
+struct ohash_elem *
+ohash_cur (struct ohash_iterator *i)
+{
+  return i->elem;
+}
+
+/* Returns the number of elements in H. */
+size_t
+ohash_size (struct ohash *h)
+{
+  return h->elem_cnt;
+}
+
+/* Returns true if H contains no elements, false otherwise. */
+bool
+ohash_empty (struct ohash *h)
+{
+  return h->elem_cnt == 0;
+}
+
+/* Returns the index of the lowest-order 1-bit in nonzero X. */
+static inline size_t
+first_set (uint32_t x)
+{
+  uint32_t idx;
+  asm ("bsfl %1, %0" : "=r" (idx) : "rm" (x) : "cc");
+  return idx;
+}
+
+/* Returns the control byte for a full slot with hash value
+   HASH. */
+static inline uint8_t
+hash_ctrl (unsigned hash)
+{
+  return hash >> 25;
+}
+
+/* Returns the control bytes of group G of T as a word. */
+static inline uint32_t
+group_word (const struct ohash_table *t, size_t g)
+{
+  return *(const uint32_t *) (t->ctrl + g * GROUP_SIZE);
+}
+
+/* Returns a word with the top bit of each byte of W that equals
+   C set, and the other bits clear.  Rarely, a byte just above a
+   matching byte is also reported as matching; the lowest bit
+   set is always a true match. */
+static inline uint32_t
+match_byte (uint32_t w, uint8_t c)
+{
+  uint32_t x = w ^ (ONES * c);
+  return (x - ONES) & ~x & HIGHS;
+}
+
+/* Returns the group at which probing for HASH in T starts. */
+static inline size_t
+first_group (const struct ohash_table *t, unsigned hash)
+{
+  return hash & (t->slot_cnt / GROUP_SIZE - 1);
+}
+
+/* Returns the group after G in T's probe sequence. */
+static inline size_t
+next_group (const struct ohash_table *t, size_t g)
+{
+  return (g + 1) & (t->slot_cnt / GROUP_SIZE - 1);
+}
+
+/* Returns the largest number of full or deleted slots allowed
+   in a table of SLOT_CNT slots. */
+static inline size_t
+max_used (size_t slot_cnt)
+{
+  return slot_cnt - slot_cnt / 8;
+}
+
+/* Searches table T in H for an element equal to E, whose hash
+   value is HASH.  Returns its slot index if found, otherwise
+   (size_t) -1. */
+static size_t
+table_find (struct ohash *h, struct ohash_table *t, struct ohash_elem *e,
+            unsigned hash)
+{
+  uint8_t c = hash_ctrl (hash);
+  size_t g;
+
+  for (g = first_group (t, hash); ; g = next_group (t, g))
+    {
+      uint32_t w = group_word (t, g);
+      uint32_t m;
+
+      for (m = match_byte (w, c); m != 0; m &= m - 1)
+        {
+          size_t idx = g * GROUP_SIZE + first_set (m) / 8;
+          struct ohash_elem *x = t->slots[idx];
+
+          if (x->hash == hash
+              && !h->less (x, e, h->aux) && !h->less (e, x, h->aux))
+            return idx;
+        }
+
+      /* An empty slot ends the probe sequence: an element
+         further along would have been put here instead. */
+      if (match_byte (w, CTRL_EMPTY) != 0)
+        return (size_t) -1;
+    }
+}
+
+/* Searches H for an element equal to E, first storing E's hash
+   value in E.  If found, sets *T to the table containing it and
+   returns its slot index.  Otherwise, sets *T to a null
+   pointer. */
+static size_t
+find_elem (struct ohash *h, struct ohash_elem *e, struct ohash_table **t)
+{
+  size_t idx;
+
+  e->hash = h->hash (e, h->aux);
+
+  idx = table_find (h, &h->cur, e, e->hash);
+  if (idx != (size_t) -1)
+    {
+      *t = &h->cur;
+      return idx;
+    }
+
+  if (h->old.slot_cnt != 0)
+    {
+      idx = table_find (h, &h->old, e, e->hash);
+      if (idx != (size_t) -1)
+        {
+          *t = &h->old;
+          return idx;
+        }
+    }
+
+  *t = NULL;
+  return 0;
+}
+
+/* Ensures that H's current table has room for one more
+   element, starting a resize if necessary. */
+static void
+make_room (struct ohash *h)
+{
+  if (h->cur.used_cnt < max_used (h->cur.slot_cnt))
+    return;
+
+  /* Finish any resize in progress before starting another.  The
+     rate at which move_some() drains the old table makes this
+     rare. */
+  while (h->old.slot_cnt != 0)
+    move_some (h);
+
+  if (h->cur.used_cnt >= max_used (h->cur.slot_cnt)
+      && !start_resize (h, h->elem_cnt + 1))
+    {
+      /* Allocation failed.  The table is still usable, just
+         slower, until its last empty slot is gone. */
+      if (h->cur.used_cnt + 1 >= h->cur.slot_cnt)
+        PANIC ("out of memory growing hash table");
+    }
+}
+
+/* Starts resizing H into a new table sized for ELEM_CNT
+   elements, that is, at most half full.  Returns true if
+   successful, false if memory allocation failed. */
+static bool
+start_resize (struct ohash *h, size_t elem_cnt)
+{
+  struct ohash_table new;
+  size_t slot_cnt;
+
+  ASSERT (h->old.slot_cnt == 0);
+
+  for (slot_cnt = MIN_SLOTS; slot_cnt < elem_cnt * 2; slot_cnt *= 2)
+    continue;
+  if (!table_init (&new, slot_cnt))
+    return false;
+
+  h->old = h->cur;
+  h->cur = new;
+  h->move_idx = 0;
+  move_some (h);
+  return true;
+}
+
+/* If H is being resized, moves some of the elements in its old
+   table into its current table, and frees the old table once it
+   is empty.
+
+   The new table is at most half full when a resize starts, so
+   it has room for at least 3/8 of its slots' worth of
+   insertions before it needs to grow again.  Moving at least
+   4 * old / new slots per call drains the old table well before
+   that. */
+static void
+move_some (struct ohash *h)
+{
+  size_t cnt, end;
+
+  if (h->old.slot_cnt == 0)
+    return;
+
+  cnt = 4 * h->old.slot_cnt / h->cur.slot_cnt;
+  if (cnt < MOVE_SLOTS)
+    cnt = MOVE_SLOTS;
+  end = h->move_idx + cnt;
+  if (end > h->old.slot_cnt)
+    end = h->old.slot_cnt;
+
+  for (; h->move_idx < end; h->move_idx++)
+    if (h->old.ctrl[h->move_idx] < CTRL_EMPTY)
+      {
+        /* Leave a deleted marker, not an empty one, so that
+           probe sequences through this slot stay intact. */
+        table_put (&h->cur, h->old.slots[h->move_idx]);
+        h->old.ctrl[h->move_idx] = CTRL_DELETED;
+      }
+
+  if (h->move_idx >= h->old.slot_cnt)
+    table_free (&h->old);
+}
+
+/* Initializes T as an empty table with SLOT_CNT slots, which
+   must be a power of 2 no less than GROUP_SIZE.  Returns true if
+   successful, false if memory allocation failed. */
+static bool
+table_init (struct ohash_table *t, size_t slot_cnt)
+{
+  /* The slot pointers follow the control bytes in a single
+     block.  SLOT_CNT is a multiple of 4, so they are aligned. */
+  t->ctrl = malloc (slot_cnt + slot_cnt * sizeof *t->slots);
+  if (t->ctrl == NULL)
+    {
+      t->slot_cnt = 0;
+      return false;
+    }
+
+  t->slot_cnt = slot_cnt;
+  t->used_cnt = 0;
+  t->slots = (struct ohash_elem **) (t->ctrl + slot_cnt);
+  memset (t->ctrl, CTRL_EMPTY, slot_cnt);
+  return true;
+}
+
+/* Frees the memory used by T, leaving it with no slots. */
+static void
+table_free (struct ohash_table *t)
+{
+  free (t->ctrl);
+  t->slot_cnt = 0;
+  t->used_cnt = 0;
+  t->ctrl = NULL;
+  t->slots = NULL;
+}
+
+/* Puts E, whose hash value is already cached, into the first
+   free slot in its probe sequence in T.  T must have at least
+   one free slot. */
+static void
+table_put (struct ohash_table *t, struct ohash_elem *e)
+{
+  size_t g, idx;
+  uint32_t m;
+
+  /* Empty and deleted slots both have the top bit set. */
+  g = first_group (t, e->hash);
+  while ((m = group_word (t, g) & HIGHS) == 0)
+    g = next_group (t, g);
+
+  idx = g * GROUP_SIZE + first_set (m) / 8;
+  if (t->ctrl[idx] == CTRL_EMPTY)
+    t->used_cnt++;
+  t->ctrl[idx] = hash_ctrl (e->hash);
+  t->slots[idx] = e;
+}
+
+/* Removes the element in slot IDX of T. */
+static void
+table_remove (struct ohash_table *t, size_t idx)
+{
+  /* If the slot's group has an empty slot, then no probe
+     sequence has ever continued past this group, so the slot can
+     become empty again.  Otherwise it must be marked deleted. */
+  if (match_byte (group_word (t, idx / GROUP_SIZE), CTRL_EMPTY) != 0)
+    {
+      t->ctrl[idx] = CTRL_EMPTY;
+      t->used_cnt--;
+    }
+  else
+    t->ctrl[idx] = CTRL_DELETED;
+}
@@ -0,0 +1,122 @@
+#ifndef __LIB_KERNEL_OHASH_H
+#define __LIB_KERNEL_OHASH_H
+
+/* Open-addressing hash table.
+
+   This is an alternative to the chained hash table in hash.h,
+   with the same interface: every function, type, and macro
+   there has a counterpart here whose name begins with "ohash"
+   instead of "hash".  Switching a table from one to the other
+   is a matter of renaming.
+
+   Like hash.h, the table is intrusive: each structure that can
+   be in an ohash embeds a struct ohash_elem member, and the
+   ohash_entry macro converts back from the member to the
+   structure.  Unlike hash.h, the table does not link elements
+   together.  Instead, it keeps an array of pointers to elements
+   ("slots") alongside an array of one-byte control codes, one
+   per slot.  A control byte says whether its slot is empty,
+   deleted, or full, and for full slots holds 7 bits of the
+   element's hash value.  A lookup examines control bytes four
+   at a time, a word at a time, and only follows a slot pointer
+   when the 7 bits match, so a typical lookup touches one word
+   of control bytes and one element instead of a list node per
+   element in the bucket.
+
+   When the table fills up, it does not rehash everything at
+   once.  It allocates a new, larger array and moves a few
+   elements from the old array to the new one on each later
+   insertion or deletion, so that no single operation takes
+   time proportional to the table's size.  Lookups check both
+   arrays until the move is complete.
+
+   Each struct ohash_elem caches its element's hash value, so
+   the hash function is called only once per insertion and once
+   per lookup, never during resizing. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Hash element. */
+struct ohash_elem
+  {
+    unsigned hash;              /* Cached hash value. */
+  };
+
+/* Converts pointer to hash element OHASH_ELEM into a pointer to
+   the structure that OHASH_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the hash element. */
+#define ohash_entry(OHASH_ELEM, STRUCT, MEMBER)                 \
+        ((STRUCT *) ((uint8_t *) &(OHASH_ELEM)->hash            \
+                     - offsetof (STRUCT, MEMBER.hash)))
+
+/* Computes and returns the hash value for hash element E, given
+   auxiliary data AUX. */
+typedef unsigned ohash_hash_func (const struct ohash_elem *e, void *aux);
+
+/* Compares the value of two hash elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool ohash_less_func (const struct ohash_elem *a,
+                              const struct ohash_elem *b,
+                              void *aux);
+
+/* Performs some operation on hash element E, given auxiliary
+   data AUX. */
+typedef void ohash_action_func (struct ohash_elem *e, void *aux);
+
+/* Array of slots and their control bytes. */
+struct ohash_table
+  {
+    size_t slot_cnt;            /* Number of slots, a power of 2. */
+    size_t used_cnt;            /* Number of full or deleted slots. */
+    uint8_t *ctrl;              /* Control byte for each slot. */
+    struct ohash_elem **slots;  /* Element in each full slot. */
+  };
+
+/* Hash table. */
+struct ohash
+  {
+    size_t elem_cnt;            /* Number of elements in table. */
+    struct ohash_table cur;     /* Table that receives insertions. */
+    struct ohash_table old;     /* Table being drained, if slot_cnt != 0. */
+    size_t move_idx;            /* Next slot of `old' to drain. */
+    ohash_hash_func *hash;      /* Hash function. */
+    ohash_less_func *less;      /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `hash' and `less'. */
+  };
+
+/* A hash table iterator. */
+struct ohash_iterator
+  {
+    struct ohash *hash;         /* The hash table. */
+    struct ohash_table *table;  /* Current table. */
+    size_t idx;                 /* Current slot in current table. */
+    struct ohash_elem *elem;    /* Current hash element. */
+  };
+
+/* Basic life cycle. */
+bool ohash_init (struct ohash *, ohash_hash_func *, ohash_less_func *,
+                 void *aux);
+void ohash_clear (struct ohash *, ohash_action_func *);
+void ohash_destroy (struct ohash *, ohash_action_func *);
+
+/* Search, insertion, deletion. */
+struct ohash_elem *ohash_insert (struct ohash *, struct ohash_elem *);
+struct ohash_elem *ohash_replace (struct ohash *, struct ohash_elem *);
+struct ohash_elem *ohash_find (struct ohash *, struct ohash_elem *);
+struct ohash_elem *ohash_delete (struct ohash *, struct ohash_elem *);
+
+/* Iteration. */
+void ohash_apply (struct ohash *, ohash_action_func *);
+void ohash_first (struct ohash_iterator *, struct ohash *);
+struct ohash_elem *ohash_next (struct ohash_iterator *);
+struct ohash_elem *ohash_cur (struct ohash_iterator *);
+
+/* Information. */
+size_t ohash_size (struct ohash *);
+bool ohash_empty (struct ohash *);
+
+#endif /* lib/kernel/ohash.h */
@@ -0,0 +1,333 @@
+#include <malloc.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* A user-space malloc(), laid out like the kernel's in
+   threads/malloc.c but getting its pages from sbrk().
+
+   Each request of up to 1 kB is rounded up to a power of 2 and
+   served from the free list of the size class for that size.
+   When the free list is empty, one page, called an "arena", is
+   added to the heap with sbrk() and carved into blocks of that
+   size.  Freed blocks go back on their class's free list.  A
+   user process has only one thread, so neither path takes a
+   lock: in the common case malloc() and free() are a list pop
+   and push.
+
+   Bigger requests get a run of whole pages, with an arena header
+   at the start recording the page count.  Freed runs are kept on
+   a list in address order, merged with free neighbors, and
+   reused, first fit, by later big requests.  A free run that
+   ends at the top of the heap is handed back to the kernel by
+   shrinking the break.  Small-block arenas are never
+   returned. */
+
+/* Page size.  Must match the kernel's. */
+#define PGSIZE 4096
+
+/* Free block. */
+struct block
+  {
+    struct block *next;         /* Next free block in the class. */
+  };
+
+/* Size class. */
+struct desc
+  {
+    size_t block_size;          /* Size of each block in bytes. */
+    struct block *free_list;    /* Free blocks. */
+  };
+
+/* Magic number for detecting arena corruption. */
+#define ARENA_MAGIC 0x9a548eed
+
+/* Arena, at the start of each page of small blocks and of each
+   run of pages holding a big block.  16 bytes, so that blocks
+   that follow it stay 16-byte aligned. */
+struct arena
+  {
+    unsigned magic;             /* Always set to ARENA_MAGIC. */
+    struct desc *desc;          /* Owning class, null for big block. */
+    size_t page_cnt;            /* Pages in big block. */
+    struct arena *next;         /* Next free big block. */
+  };
+
+/* Size classes, 16 bytes through 1 kB.  Larger blocks would not
+   fit twice into a page with its arena. */
+#define MIN_BLOCK_SHIFT 4
+static struct desc descs[] =
+  {
+    { 16, NULL }, { 32, NULL }, { 64, NULL }, { 128, NULL },
+    { 256, NULL }, { 512, NULL }, { 1024, NULL },
+  };
+#define MAX_BLOCK_SIZE 1024
+
+/* Free big blocks, in increasing address order. */
+static struct arena *free_big;
+
+static void *get_pages (size_t page_cnt);
+static void *big_alloc (size_t size);
+static void big_free (struct arena *);
+static struct arena *block_to_arena (void *);
+
+/* Returns the index of the smallest size class holding SIZE
+   bytes, 0 < SIZE <= MAX_BLOCK_SIZE. */
+static inline size_t
+size_class (size_t size)
+{
+  if (size <= 1u << MIN_BLOCK_SHIFT)
+    return 0;
+  return 32 - __builtin_clz (size - 1) - MIN_BLOCK_SHIFT;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size)
+{
+  struct desc *d;
+  struct block *b;
+
+  if (size == 0)
+    return NULL;
+  if (size > MAX_BLOCK_SIZE)
+    return big_alloc (size);
+
+  d = &descs[size_class (size)];
+  if (d->free_list == NULL)
+    {
+      /* Add a new arena and put its blocks on the free list. */
+      struct arena *a = get_pages (1);
+      size_t ofs;
+
+      if (a == NULL)
+        return NULL;
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      for (ofs = PGSIZE - d->block_size; ofs >= sizeof *a;
+           ofs -= d->block_size)
+        {
+          b = (struct block *) ((uint8_t *) a + ofs);
+          b->next = d->free_list;
+          d->free_list = b;
+        }
+    }
+
+  b = d->free_list;
+  d->free_list = b->next;
+  return b;
+}
+
+/* Allocates and returns A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b)
+{
+  void *p;
+  size_t size;
+
+  /* Calculate block size and make sure it fits in size_t. */
+  if (b != 0 && a > SIZE_MAX / b)
+    return NULL;
+  size = a * b;
+
+  /* Allocate and zero memory. */
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+
+  return p;
+}
+
+/* Returns the number of bytes allocated for BLOCK. */
+static size_t
+block_size (void *block)
+{
+  struct arena *a = block_to_arena (block);
+
+  return (a->desc != NULL
+          ? a->desc->block_size
+          : a->page_cnt * PGSIZE - ((uint8_t *) block - (uint8_t *) a));
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer.
+   A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size)
+{
+  void *new_block;
+  size_t old_size;
+
+  if (new_size == 0)
+    {
+      free (old_block);
+      return NULL;
+    }
+  if (old_block == NULL)
+    return malloc (new_size);
+
+  /* The block may already be big enough. */
+  old_size = block_size (old_block);
+  if (new_size <= old_size)
+    return old_block;
+
+  new_block = malloc (new_size);
+  if (new_block != NULL)
+    {
+      memcpy (new_block, old_block, old_size);
+      free (old_block);
+    }
+  return new_block;
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p)
+{
+  struct arena *a;
+
+  if (p == NULL)
+    return;
+
+  a = block_to_arena (p);
+  if (a->desc != NULL)
+    {
+      struct block *b = p;
+
+      b->next = a->desc->free_list;
+      a->desc->free_list = b;
+    }
+  else
+    big_free (a);
+}
+
+/* Extends the heap by PAGE_CNT pages, starting at a page
+   boundary, and returns the first of them.  Returns a null
+   pointer if the kernel refuses. */
+static void *
+get_pages (size_t page_cnt)
+{
+  uintptr_t brk = (uintptr_t) sbrk (0);
+  size_t pad = ROUND_UP (brk, PGSIZE) - brk;
+  uint8_t *p;
+
+  if (page_cnt > (INTPTR_MAX - pad) / PGSIZE)
+    return NULL;
+  p = sbrk (pad + page_cnt * PGSIZE);
+  return p != (void *) -1 ? p + pad : NULL;
+}
+
+/* Allocates a block of at least SIZE bytes from whole pages,
+   reusing a freed run if one is big enough. */
+static void *
+big_alloc (size_t size)
+{
+  struct arena **ap, *a;
+  size_t page_cnt;
+
+  if (size > SIZE_MAX - sizeof *a - PGSIZE)
+    return NULL;
+  page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
+
+  for (ap = &free_big; *ap != NULL; ap = &(*ap)->next)
+    if ((*ap)->page_cnt >= page_cnt)
+      {
+        a = *ap;
+        *ap = a->next;
+
+        /* Put any pages beyond PAGE_CNT back in A's place as a
+           run of their own. */
+        if (a->page_cnt > page_cnt)
+          {
+            struct arena *rest = (struct arena *) ((uint8_t *) a
+                                                   + page_cnt * PGSIZE);
+            rest->magic = ARENA_MAGIC;
+            rest->desc = NULL;
+            rest->page_cnt = a->page_cnt - page_cnt;
+            rest->next = *ap;
+            *ap = rest;
+            a->page_cnt = page_cnt;
+          }
+        return a + 1;
+      }
+
+  a = get_pages (page_cnt);
+  if (a == NULL)
+    return NULL;
+  a->magic = ARENA_MAGIC;
+  a->desc = NULL;
+  a->page_cnt = page_cnt;
+  return a + 1;
+}
+
+/* Returns the end of the run of pages that starts with A. */
+static uint8_t *
+arena_end (struct arena *a)
+{
+  return (uint8_t *) a + a->page_cnt * PGSIZE;
+}
+
+/* Frees big block A, merging it with adjacent free runs.  If the
+   result is at the top of the heap, shrinks the heap to give it
+   back. */
+static void
+big_free (struct arena *a)
+{
+  struct arena **ap, **prev_ap = NULL, **link;
+
+  /* Insert A in address order. */
+  for (ap = &free_big; *ap != NULL && *ap < a; ap = &(*ap)->next)
+    prev_ap = ap;
+  a->next = *ap;
+  *ap = a;
+  link = ap;
+
+  /* Merge with the following run, then with the preceding one. */
+  if (a->next != NULL && arena_end (a) == (uint8_t *) a->next)
+    {
+      a->page_cnt += a->next->page_cnt;
+      a->next = a->next->next;
+    }
+  if (prev_ap != NULL && arena_end (*prev_ap) == (uint8_t *) a)
+    {
+      struct arena *prev = *prev_ap;
+
+      prev->page_cnt += a->page_cnt;
+      prev->next = a->next;
+      a = prev;
+      link = prev_ap;
+    }
+
+  if (a->next == NULL && arena_end (a) == sbrk (0))
+    {
+      *link = NULL;
+      sbrk (-(intptr_t) (a->page_cnt * PGSIZE));
+    }
+}
+
+/* Returns the arena that block B is inside. */
+static struct arena *
+block_to_arena (void *b)
+{
+  struct arena *a = (struct arena *) ((uintptr_t) b & ~(PGSIZE - 1));
+
+  /* Check that the arena is valid. */
+  ASSERT (a != NULL);
+  ASSERT (a->magic == ARENA_MAGIC);
+
+  /* Check that the block is properly aligned for the arena. */
+  ASSERT (a->desc == NULL
+          || ((uintptr_t) b - (uintptr_t) a) % a->desc->block_size
+             == PGSIZE % a->desc->block_size);
+  ASSERT (a->desc != NULL || (struct arena *) b == a + 1);
+
+  return a;
+}
@@ -4,4 +4,27 @@
 int hprintf (int, const char *, ...) PRINTF_FORMAT (2, 3);
 int vhprintf (int, const char *, va_list) PRINTF_FORMAT (2, 0);
 
+/* Buffered output streams.  See stream.c. */
+typedef struct FILE FILE;
+extern FILE *stdout;
+
+/* Buffering modes for setvbuf(). */
+#define _IOFBF 0                /* Full buffering. */
+#define _IOLBF 1                /* Line buffering. */
+#define _IONBF 2                /* No buffering. */
+
+#define BUFSIZ 512              /* Default (and maximum) buffer size. */
+#define FOPEN_MAX 8             /* Maximum open streams, with stdout. */
+#define EOF (-1)                /* Error return value. */
+
+FILE *fdopen (int fd, const char *mode);
+int setvbuf (FILE *, char *buf, int mode, size_t size);
+int fflush (FILE *);
+int fclose (FILE *);
+int fputc (int, FILE *);
+int fputs (const char *, FILE *);
+size_t fwrite (const void *, size_t size, size_t cnt, FILE *);
+int fprintf (FILE *, const char *, ...) PRINTF_FORMAT (2, 3);
+int vfprintf (FILE *, const char *, va_list) PRINTF_FORMAT (2, 0);
+
 #endif /* lib/user/stdio.h */
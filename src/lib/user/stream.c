@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Buffered output streams.
+
+   Each stream collects output in a buffer and writes it with a
+   single system call when the buffer fills, or when fflush() or
+   fclose() is called, or at exit().  A line-buffered stream also
+   writes its buffer whenever a new-line is output.  stdout,
+   which goes to the console, is line-buffered, so that output
+   still appears a line at a time, interleaved sensibly with the
+   kernel's messages.  Streams opened with fdopen() are fully
+   buffered.
+
+   Buffers and streams come from static arrays, so that output
+   works without touching the heap. */
+struct FILE
+  {
+    int fd;                     /* File descriptor. */
+    int mode;                   /* _IOFBF, _IOLBF, or _IONBF. */
+    char *buf;                  /* Buffer. */
+    size_t size;                /* Buffer capacity. */
+    size_t used;                /* Bytes in buffer. */
+    bool in_use;                /* Is this stream open? */
+    bool error;                 /* Has a write failed? */
+  };
+
+/* Default buffers, one per stream. */
+static char buffers[FOPEN_MAX][BUFSIZ];
+
+/* Streams.  The first is stdout. */
+static FILE streams[FOPEN_MAX] =
+  {
+    { STDOUT_FILENO, _IOLBF, buffers[0], BUFSIZ, 0, true, false },
+  };
+
+FILE *stdout = &streams[0];
+
+/* Writes the SIZE bytes at DATA to STREAM's file descriptor.
+   Returns true if successful, false on error. */
+static bool
+write_out (FILE *stream, const char *data, size_t size)
+{
+  while (size > 0)
+    {
+      int n = write (stream->fd, data, size);
+      if (n <= 0)
+        {
+          stream->error = true;
+          return false;
+        }
+      data += n;
+      size -= n;
+    }
+  return true;
+}
+
+/* Writes STREAM's buffer to its file descriptor and empties it.
+   Returns true if successful, false on error. */
+static bool
+flush_buffer (FILE *stream)
+{
+  size_t used = stream->used;
+
+  stream->used = 0;
+  return used == 0 || write_out (stream, stream->buf, used);
+}
+
+/* Adds the SIZE bytes at DATA to STREAM, writing the buffer out
+   as needed.  Returns true if successful, false on error. */
+static bool
+put_bytes (FILE *stream, const char *data, size_t size)
+{
+  size_t room = stream->size - stream->used;
+  bool new_line;
+
+  if (stream->mode == _IONBF)
+    return write_out (stream, data, size);
+
+  new_line = (stream->mode == _IOLBF
+              && memchr (data, '\n', size) != NULL);
+
+  if (size < room)
+    {
+      /* Common case: it fits. */
+      memcpy (stream->buf + stream->used, data, size);
+      stream->used += size;
+    }
+  else
+    {
+      /* Fill and write out the buffer, then write whatever does
+         not fit in an empty buffer directly rather than copying
+         it in, and buffer the rest. */
+      size_t tail;
+
+      memcpy (stream->buf + stream->used, data, room);
+      stream->used += room;
+      data += room;
+      size -= room;
+      if (!flush_buffer (stream))
+        return false;
+
+      tail = size % stream->size;
+      if (size > tail && !write_out (stream, data, size - tail))
+        return false;
+      memcpy (stream->buf, data + size - tail, tail);
+      stream->used = tail;
+    }
+
+  return new_line ? flush_buffer (stream) : true;
+}
+
+/* Opens a buffered output stream on file descriptor FD.  MODE
+   must be "w" or "a"; input streams are not supported.  Returns
+   the new stream, or a null pointer if MODE is invalid or
+   FOPEN_MAX streams are already open. */
+FILE *
+fdopen (int fd, const char *mode)
+{
+  size_t i;
+
+  if (mode[0] != 'w' && mode[0] != 'a')
+    return NULL;
+
+  for (i = 0; i < FOPEN_MAX; i++)
+    if (!streams[i].in_use)
+      {
+        FILE *stream = &streams[i];
+        stream->fd = fd;
+        stream->mode = _IOFBF;
+        stream->buf = buffers[i];
+        stream->size = BUFSIZ;
+        stream->used = 0;
+        stream->in_use = true;
+        stream->error = false;
+        return stream;
+      }
+  return NULL;
+}
+
+/* Sets STREAM's buffering MODE to _IOFBF, _IOLBF, or _IONBF.
+   If BUF is nonnull, STREAM will use the SIZE bytes at BUF as
+   its buffer; otherwise, it uses its own buffer, limited to SIZE
+   bytes if SIZE is between 1 and BUFSIZ.  Any buffered output is
+   written first.  Returns 0 if successful, nonzero on error. */
+int
+setvbuf (FILE *stream, char *buf, int mode, size_t size)
+{
+  if (mode != _IOFBF && mode != _IOLBF && mode != _IONBF)
+    return EOF;
+  if (!flush_buffer (stream))
+    return EOF;
+
+  if (buf != NULL && size > 0)
+    {
+      stream->buf = buf;
+      stream->size = size;
+    }
+  else
+    {
+      stream->buf = buffers[stream - streams];
+      stream->size = size > 0 && size < BUFSIZ ? size : BUFSIZ;
+    }
+  stream->mode = mode;
+  return 0;
+}
+
+/* Writes any output buffered in STREAM, or in every open stream
+   if STREAM is a null pointer.  Returns 0 if successful, EOF on
+   error. */
+int
+fflush (FILE *stream)
+{
+  int retval = 0;
+
+  if (stream != NULL)
+    return flush_buffer (stream) ? 0 : EOF;
+
+  for (stream = streams; stream < streams + FOPEN_MAX; stream++)
+    if (stream->in_use && !flush_buffer (stream))
+      retval = EOF;
+  return retval;
+}
+
+/* Flushes and closes STREAM and its file descriptor.  Closing
+   stdout only flushes it.  Returns 0 if successful, EOF on
+   error. */
+int
+fclose (FILE *stream)
+{
+  bool ok = flush_buffer (stream) && !stream->error;
+
+  if (stream != stdout)
+    {
+      close (stream->fd);
+      stream->in_use = false;
+    }
+  return ok ? 0 : EOF;
+}
+
+/* Writes C to STREAM.  Returns C if successful, EOF on error. */
+int
+fputc (int c, FILE *stream)
+{
+  char ch = c;
+
+  if (stream->used + 1 < stream->size && ch != '\n'
+      && stream->mode != _IONBF)
+    {
+      /* Fast path for the common case. */
+      stream->buf[stream->used++] = ch;
+      return (unsigned char) ch;
+    }
+  return put_bytes (stream, &ch, 1) ? (unsigned char) ch : EOF;
+}
+
+/* Writes string S to STREAM.  Returns a nonnegative value if
+   successful, EOF on error. */
+int
+fputs (const char *s, FILE *stream)
+{
+  return put_bytes (stream, s, strlen (s)) ? 0 : EOF;
+}
+
+/* Writes CNT objects of SIZE bytes each from DATA to STREAM.
+   Returns the number of objects written, which is less than CNT
+   only on error. */
+size_t
+fwrite (const void *data, size_t size, size_t cnt, FILE *stream)
+{
+  if (size == 0 || cnt == 0)
+    return 0;
+  return put_bytes (stream, data, size * cnt) ? cnt : 0;
+}
+
+/* Auxiliary data for vfprintf_helper(). */
+struct vfprintf_aux
+  {
+    FILE *stream;               /* Output stream. */
+    int char_cnt;               /* Characters written so far. */
+    bool error;                 /* Has a write failed? */
+  };
+
+/* Writes C to the stream in AUX. */
+static void
+vfprintf_helper (char c, void *aux_)
+{
+  struct vfprintf_aux *aux = aux_;
+  if (fputc (c, aux->stream) == EOF)
+    aux->error = true;
+  aux->char_cnt++;
+}
+
+/* Formats the printf() format specification FORMAT with
+   arguments given in ARGS and writes the output to STREAM.
+   Returns the number of characters written, or -1 on error. */
+int
+vfprintf (FILE *stream, const char *format, va_list args)
+{
+  struct vfprintf_aux aux;
+
+  aux.stream = stream;
+  aux.char_cnt = 0;
+  aux.error = false;
+  __vprintf (format, args, vfprintf_helper, &aux);
+  return aux.error ? -1 : aux.char_cnt;
+}
+
+/* Like printf(), but writes output to STREAM. */
+int
+fprintf (FILE *stream, const char *format, ...)
+{
+  va_list args;
+  int retval;
+
+  va_start (args, format);
+  retval = vfprintf (stream, format, args);
+  va_end (args);
+
+  return retval;
+}
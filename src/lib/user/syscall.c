@@ -1,31 +1,61 @@
 #include <syscall.h>
+#include <stdio.h>
 #include "../syscall-nr.h"
 
+/* True to enter the kernel with SYSENTER, false to use
+   `int $0x30'.  Set by syscall_select_entry(). */
+bool syscall_sysenter;
+
+/* System calls load the system call number into EAX and up to
+   four arguments into EBX, ESI, EDI, and EBP, and return a value
+   in EAX.  ECX and EDX are not used for arguments because the
+   kernel's SYSENTER entry point expects our stack pointer in ECX
+   and the address to return to in EDX.
+
+   SYSCALL_INSNS enters the kernel with SYSENTER if
+   syscall_sysenter is set, and the kernel takes the number and
+   arguments from those registers.  Otherwise it pushes them on
+   the stack, number lowest, and uses `int $0x30', for which the
+   kernel reads them from the stack as in the original ABI.  It
+   always pushes four arguments; the kernel reads only as many
+   as the system call takes. */
+#define SYSCALL_INSNS                                           \
+        "cmpb $0, %[fast]; je 1f; "                             \
+        "movl %%esp, %%ecx; movl $2f, %%edx; sysenter; "        \
+        SYSCALL_INT_INSNS "2:"
+
+/* Pushes the number and arguments and executes `int $0x30'. */
+#define SYSCALL_INT_INSNS                                       \
+        "1: pushl %%ebp; pushl %%edi; pushl %%esi; "            \
+        "pushl %%ebx; pushl %%eax; int $0x30; addl $20, %%esp; "
+
 /* Invokes syscall NUMBER, passing no arguments, and returns the
    return value as an `int'. */
 #define syscall0(NUMBER)                                        \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
-            ("pushl %[number]; int $0x30; addl $4, %%esp"       \
+            (SYSCALL_INSNS                                      \
                : "=a" (retval)                                  \
-               : [number] "i" (NUMBER)                          \
-               : "memory");                                     \
+               : "0" (NUMBER),                                  \
+                 [fast] "m" (syscall_sysenter)                  \
+               : "ecx", "edx", "memory");                       \
           retval;                                               \
         })
 
 /* Invokes syscall NUMBER, passing argument ARG0, and returns the
    return value as an `int'. */
-#define syscall1(NUMBER, ARG0)                                           \
-        ({                                                               \
-          int retval;                                                    \
-          asm volatile                                                   \
-            ("pushl %[arg0]; pushl %[number]; int $0x30; addl $8, %%esp" \
-               : "=a" (retval)                                           \
-               : [number] "i" (NUMBER),                                  \
-                 [arg0] "g" (ARG0)                                       \
-               : "memory");                                              \
-          retval;                                                        \
+#define syscall1(NUMBER, ARG0)                                  \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            (SYSCALL_INSNS                                      \
+               : "=a" (retval)                                  \
+               : "0" (NUMBER),                                  \
+                 [fast] "m" (syscall_sysenter),                 \
+                 "b" (ARG0)                                     \
+               : "ecx", "edx", "memory");                       \
+          retval;                                               \
         })
 
 /* Invokes syscall NUMBER, passing arguments ARG0 and ARG1, and
@@ -34,13 +64,13 @@
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
-            ("pushl %[arg1]; pushl %[arg0]; "                   \
-             "pushl %[number]; int $0x30; addl $12, %%esp"      \
+            (SYSCALL_INSNS                                      \
                : "=a" (retval)                                  \
-               : [number] "i" (NUMBER),                         \
-                 [arg0] "g" (ARG0),                             \
-                 [arg1] "g" (ARG1)                              \
-               : "memory");                                     \
+               : "0" (NUMBER),                                  \
+                 [fast] "m" (syscall_sysenter),                 \
+                 "b" (ARG0),                                    \
+                 "S" (ARG1)                                     \
+               : "ecx", "edx", "memory");                       \
           retval;                                               \
         })
 
@@ -50,17 +80,63 @@
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
-            ("pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "    \
-             "pushl %[number]; int $0x30; addl $16, %%esp"      \
+            (SYSCALL_INSNS                                      \
                : "=a" (retval)                                  \
-               : [number] "i" (NUMBER),                         \
-                 [arg0] "g" (ARG0),                             \
-                 [arg1] "g" (ARG1),                             \
-                 [arg2] "g" (ARG2)                              \
+               : "0" (NUMBER),                                  \
+                 [fast] "m" (syscall_sysenter),                 \
+                 "b" (ARG0),                                    \
+                 "S" (ARG1),                                    \
+                 "D" (ARG2)                                     \
+               : "ecx", "edx", "memory");                       \
+          retval;                                               \
+        })
+
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'.
+
+   The fourth argument goes in EBP, which we must save and
+   restore ourselves.  Between changing EBP and restoring it, no
+   operand may be addressed relative to EBP or ESP, so ARG3 comes
+   in through ECX and syscall_sysenter through EDX, which the
+   SYSENTER path overwrites anyway. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          int arg3 = (int) (ARG3);                              \
+          int fast = syscall_sysenter;                          \
+          asm volatile                                          \
+            ("pushl %%ebp; movl %%ecx, %%ebp; "                 \
+             "testl %%edx, %%edx; jz 1f; "                      \
+             "movl %%esp, %%ecx; movl $2f, %%edx; sysenter; "   \
+             SYSCALL_INT_INSNS "2: popl %%ebp"                  \
+               : "=a" (retval), "+c" (arg3), "+d" (fast)        \
+               : "0" (NUMBER),                                  \
+                 "b" (ARG0),                                    \
+                 "S" (ARG1),                                    \
+                 "D" (ARG2)                                     \
                : "memory");                                     \
           retval;                                               \
         })
 
+/* Sets syscall_sysenter if the CPU supports SYSENTER/SYSEXIT.
+   The kernel enables that path under the same conditions (see
+   tss_enable_sysenter() in userprog/tss.c). */
+void
+syscall_select_entry (void)
+{
+  unsigned eax, ebx, ecx, edx;
+  unsigned family, model, stepping;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+
+  /* The Pentium Pro reports SEP but does not implement it. */
+  syscall_sysenter = ((edx & (1u << 11)) != 0
+                      && !(family == 6 && model < 3 && stepping < 3));
+}
+
 void
 halt (void) 
 {
@@ -71,6 +147,9 @@ halt (void)
 void
 exit (int status)
 {
+  /* Write out buffered output, including when main() returns
+     to _start() in entry.c. */
+  fflush (NULL);
   syscall1 (SYS_EXIT, status);
   NOT_REACHED ();
 }
@@ -182,3 +261,33 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+pread (int fd, void *buffer, unsigned size, unsigned position)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, position);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned position)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, position);
+}
+
+void *
+sbrk (intptr_t increment)
+{
+  return (void *) syscall1 (SYS_SBRK, increment);
+}
@@ -2,7 +2,9 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <debug.h>
+#include <iovec.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -45,4 +47,15 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+int readv (int fd, const struct iovec *iov, int iovcnt);
+int writev (int fd, const struct iovec *iov, int iovcnt);
+int pread (int fd, void *buffer, unsigned length, unsigned position);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned position);
+void *sbrk (intptr_t increment);
+
+/* System call entry, selected by _start() in entry.c. */
+extern bool syscall_sysenter;
+void syscall_select_entry (void);
+
 #endif /* lib/user/syscall.h */
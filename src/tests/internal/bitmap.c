@@ -0,0 +1,265 @@
+/* Test program and micro-benchmark for lib/kernel/bitmap.c.
+
+   Checks bitmap_scan(), bitmap_count(), bitmap_contains(), and
+   bitmap_set_multiple() against a simple bit-at-a-time
+   reference implementation on randomly fragmented bitmaps, both
+   plain and two-level, checks bitmap_scan_and_flip_next(), then
+   times bitmap_scan() against the reference on fragmented maps
+   of increasing size.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <bitmap.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Maximum number of bits in a bitmap that we will test. */
+#define MAX_BITS 4096
+
+/* Number of scans timed for each benchmark. */
+#define SCAN_CNT 200
+
+static void fragment (struct bitmap *, int percent_used);
+static size_t ref_scan (const struct bitmap *, size_t start, size_t cnt,
+                        bool);
+static size_t ref_count (const struct bitmap *, size_t start, size_t cnt,
+                         bool);
+static void verify (const struct bitmap *);
+static void test_sizes (bool two_level);
+static void test_next_fit (void);
+static void benchmark (size_t bit_cnt, int percent_used, size_t run);
+static uint64_t rdtsc (void);
+
+/* Test the bitmap implementation. */
+void
+test (void)
+{
+  test_sizes (false);
+  test_sizes (true);
+  test_next_fit ();
+
+  printf ("benchmarking bitmap_scan (cycles per scan, new vs. reference):\n");
+  benchmark (1024, 50, 4);
+  benchmark (4096, 50, 4);
+  benchmark (4096, 90, 8);
+  benchmark (16384, 90, 8);
+  benchmark (16384, 97, 16);
+  benchmark (16384, 99, 1);
+
+  printf ("bitmap: PASS\n");
+}
+
+/* Tests bitmaps of various sizes, two-level ones if TWO_LEVEL
+   is true. */
+static void
+test_sizes (bool two_level) 
+{
+  size_t bit_cnt;
+
+  printf ("testing various size %sbitmaps:", two_level ? "two-level " : "");
+  for (bit_cnt = 0; bit_cnt <= MAX_BITS; bit_cnt = bit_cnt * 3 / 2 + 1)
+    {
+      struct bitmap *b = (two_level
+                          ? bitmap_create_two_level (bit_cnt)
+                          : bitmap_create (bit_cnt));
+      int percent;
+
+      ASSERT (b != NULL);
+      printf (" %zu", bit_cnt);
+      for (percent = 0; percent <= 100; percent += 10)
+        {
+          size_t i;
+
+          fragment (b, percent);
+          verify (b);
+
+          /* Set and clear random ranges and verify again. */
+          for (i = 0; i < 8 && bit_cnt > 0; i++)
+            {
+              size_t start = random_ulong () % bit_cnt;
+              size_t cnt = random_ulong () % (bit_cnt - start + 1);
+              bool value = random_ulong () % 2;
+              size_t j;
+
+              bitmap_set_multiple (b, start, cnt, value);
+              for (j = 0; j < cnt; j++)
+                ASSERT (bitmap_test (b, start + j) == value);
+              verify (b);
+            }
+
+          /* Flip single bits, which may fill or unfill an
+             element, and verify again. */
+          for (i = 0; i < 16 && bit_cnt > 0; i++)
+            bitmap_flip (b, random_ulong () % bit_cnt);
+          verify (b);
+        }
+      bitmap_destroy (b);
+    }
+  printf (" done\n");
+}
+
+/* Tests that bitmap_scan_and_flip_next() allocates a two-level
+   bitmap in next-fit order, wraps around, and fails only when
+   no group is free. */
+static void
+test_next_fit (void) 
+{
+  struct bitmap *b = bitmap_create_two_level (1000);
+  size_t i;
+
+  printf ("testing next-fit allocation:");
+  ASSERT (b != NULL);
+  for (i = 0; i < 100; i++)
+    ASSERT (bitmap_scan_and_flip_next (b, 10, false) == i * 10);
+  ASSERT (bitmap_scan_and_flip_next (b, 1, false) == BITMAP_ERROR);
+
+  /* Free two groups.  The cursor is at the end, so the search
+     wraps around and finds the earlier one first. */
+  bitmap_set_multiple (b, 500, 10, false);
+  bitmap_set_multiple (b, 20, 10, false);
+  ASSERT (bitmap_scan_and_flip_next (b, 10, false) == 20);
+  ASSERT (bitmap_scan_and_flip_next (b, 10, false) == 500);
+  ASSERT (bitmap_scan_and_flip_next (b, 10, false) == BITMAP_ERROR);
+
+  /* Single bits after the cursor are preferred over ones before
+     it. */
+  bitmap_reset (b, 3);
+  bitmap_reset (b, 700);
+  ASSERT (bitmap_scan_and_flip_next (b, 1, false) == 700);
+  ASSERT (bitmap_scan_and_flip_next (b, 1, false) == 3);
+  ASSERT (bitmap_all (b, 0, 1000));
+  bitmap_destroy (b);
+  printf (" done\n");
+}
+
+/* Sets about PERCENT_USED percent of B's bits to true, in runs
+   of random length, and the rest to false. */
+static void
+fragment (struct bitmap *b, int percent_used)
+{
+  size_t i = 0;
+
+  while (i < bitmap_size (b))
+    {
+      size_t run = 1 + random_ulong () % 48;
+      bool used = (int) (random_ulong () % 100) < percent_used;
+
+      if (run > bitmap_size (b) - i)
+        run = bitmap_size (b) - i;
+      bitmap_set_multiple (b, i, run, used);
+      i += run;
+    }
+}
+
+/* Verifies the word-at-a-time operations on B against the
+   reference implementations, at a random sample of starting
+   points and lengths, mostly short ones. */
+static void
+verify (const struct bitmap *b)
+{
+  size_t bit_cnt = bitmap_size (b);
+  int i;
+
+  for (i = 0; i < 64; i++)
+    {
+      size_t start = random_ulong () % (bit_cnt + 1);
+      size_t max_cnt = bit_cnt - start;
+      size_t cnt = random_ulong () % (max_cnt + 1);
+      size_t true_cnt;
+
+      if (i % 4 != 0 && cnt > 70)
+        cnt %= 70;
+      true_cnt = ref_count (b, start, cnt, true);
+
+      ASSERT (bitmap_scan (b, start, cnt, true)
+              == ref_scan (b, start, cnt, true));
+      ASSERT (bitmap_scan (b, start, cnt, false)
+              == ref_scan (b, start, cnt, false));
+      ASSERT (bitmap_count (b, start, cnt, true) == true_cnt);
+      ASSERT (bitmap_count (b, start, cnt, false) == cnt - true_cnt);
+      ASSERT (bitmap_contains (b, start, cnt, true) == (true_cnt > 0));
+      ASSERT (bitmap_contains (b, start, cnt, false)
+              == (true_cnt < cnt));
+    }
+}
+
+/* Times SCAN_CNT scans for RUN false bits from random starting
+   points in a BIT_CNT-bit map that is PERCENT_USED percent
+   full, using bitmap_scan() and the reference, and prints the
+   average cycle counts. */
+static void
+benchmark (size_t bit_cnt, int percent_used, size_t run)
+{
+  struct bitmap *b = bitmap_create_two_level (bit_cnt);
+  static size_t starts[SCAN_CNT];
+  uint64_t fast, slow, t;
+  size_t i;
+
+  ASSERT (b != NULL);
+  fragment (b, percent_used);
+  for (i = 0; i < SCAN_CNT; i++)
+    starts[i] = random_ulong () % bit_cnt;
+
+  t = rdtsc ();
+  for (i = 0; i < SCAN_CNT; i++)
+    bitmap_scan (b, starts[i], run, false);
+  fast = rdtsc () - t;
+
+  t = rdtsc ();
+  for (i = 0; i < SCAN_CNT; i++)
+    ref_scan (b, starts[i], run, false);
+  slow = rdtsc () - t;
+
+  printf ("  %6zu bits, %2d%% used, run %2zu: %8"PRIu64" vs. %8"PRIu64"\n",
+          bit_cnt, percent_used, run, fast / SCAN_CNT, slow / SCAN_CNT);
+  bitmap_destroy (b);
+}
+
+/* Reference bitmap_scan(): tests every candidate start bit by
+   bit, as bitmap_scan() used to. */
+static size_t
+ref_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  if (cnt <= bitmap_size (b))
+    {
+      size_t last = bitmap_size (b) - cnt;
+      size_t i;
+      for (i = start; i <= last; i++)
+        {
+          size_t j;
+          for (j = 0; j < cnt; j++)
+            if (bitmap_test (b, i + j) != value)
+              break;
+          if (j == cnt)
+            return i;
+        }
+    }
+  return BITMAP_ERROR;
+}
+
+/* Reference bitmap_count(). */
+static size_t
+ref_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t i, value_cnt = 0;
+
+  for (i = 0; i < cnt; i++)
+    if (bitmap_test (b, start + i) == value)
+      value_cnt++;
+  return value_cnt;
+}
+
+/* Returns the CPU's time-stamp counter. */
+static uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
@@ -0,0 +1,226 @@
+/* Test program for the hash functions in lib/kernel/hash.c.
+
+   Hashes sets of keys typical of the kernel's tables, such as
+   runs of consecutive user pages and kernel frames and strings
+   that differ only in a numeric suffix, and checks with a
+   chi-squared test that the hash values are spread evenly over
+   both the low bits, which hash.c uses to pick a bucket, and the
+   high bits, which ohash.c stores in its control bytes.  Also
+   checks that hash_string() does not depend on the string's
+   alignment and that different seeds give different hashes, and
+   times each function against the byte-at-a-time hash_bytes().
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <hash.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/test.h"
+#include "threads/vaddr.h"
+
+/* Number of keys in each set. */
+#define KEY_CNT 4096
+
+/* Number of buckets for the low-bits test, and number of
+   distinct values in the top 7 bits. */
+#define LOW_BUCKETS 256
+#define HIGH_BUCKETS 128
+
+/* A set of keys. */
+enum key_set
+  {
+    USER_PAGES,                 /* Consecutive pages from 0x08048000. */
+    STACK_PAGES,                /* Consecutive pages below PHYS_BASE. */
+    KERNEL_FRAMES,              /* Every other page from 0xc0100000. */
+    INTS,                       /* 0, 1, 2, .... */
+    STRIDED_INTS,               /* 0, 1024, 2048, .... */
+    NAMES,                      /* "file0", "file1", .... */
+    KEY_SET_CNT
+  };
+
+static const char *key_set_names[KEY_SET_CNT] =
+  {
+    "user pages", "stack pages", "kernel frames",
+    "ints", "strided ints", "names",
+  };
+
+/* Keys in the NAMES set. */
+static char names[KEY_CNT][16];
+
+static unsigned hash_key (enum key_set, size_t i, bool fnv);
+static unsigned chi_squared (const unsigned hashes[], int shift, size_t m);
+static void test_alignment (void);
+static void test_seeds (void);
+static uint64_t rdtsc (void);
+
+/* Test the hash functions. */
+void
+test (void)
+{
+  static unsigned hashes[KEY_CNT];
+  enum key_set set;
+  size_t i;
+
+  for (i = 0; i < KEY_CNT; i++)
+    snprintf (names[i], sizeof names[i], "file%zu", i);
+
+  printf ("chi-squared (expect about %d for low bits, %d for high bits):\n",
+          LOW_BUCKETS - 1, HIGH_BUCKETS - 1);
+  for (set = 0; set < KEY_SET_CNT; set++)
+    {
+      unsigned low, high, fnv_low, fnv_high;
+      uint64_t t, fast, slow;
+
+      t = rdtsc ();
+      for (i = 0; i < KEY_CNT; i++)
+        hashes[i] = hash_key (set, i, false);
+      fast = rdtsc () - t;
+      low = chi_squared (hashes, 0, LOW_BUCKETS);
+      high = chi_squared (hashes, 25, HIGH_BUCKETS);
+
+      t = rdtsc ();
+      for (i = 0; i < KEY_CNT; i++)
+        hashes[i] = hash_key (set, i, true);
+      slow = rdtsc () - t;
+      fnv_low = chi_squared (hashes, 0, LOW_BUCKETS);
+      fnv_high = chi_squared (hashes, 25, HIGH_BUCKETS);
+
+      printf ("  %-13s low %4u (FNV %4u), high %4u (FNV %4u), "
+              "%3"PRIu64" vs. %3"PRIu64" cycles\n",
+              key_set_names[set], low, fnv_low, high, fnv_high,
+              fast / KEY_CNT, slow / KEY_CNT);
+
+      /* Far above 2 * (buckets - 1) is a sign of clustering.  The
+         multiplicative hashes should spread these regular key
+         sets better than random, well under buckets - 1 in the
+         low bits. */
+      ASSERT (low < (set == NAMES ? 2 * LOW_BUCKETS : LOW_BUCKETS / 2));
+      ASSERT (high < 2 * HIGH_BUCKETS);
+    }
+
+  test_alignment ();
+  test_seeds ();
+  printf ("hash: PASS\n");
+}
+
+/* Returns the hash of key I in SET, computed with hash_bytes()
+   if FNV is true or with the specialized hash function
+   otherwise. */
+static unsigned
+hash_key (enum key_set set, size_t i, bool fnv)
+{
+  void *page;
+  int n;
+
+  switch (set)
+    {
+    case USER_PAGES:
+      page = (void *) (0x08048000 + i * PGSIZE);
+      return fnv ? hash_bytes (&page, sizeof page) : hash_page (page);
+    case STACK_PAGES:
+      page = (uint8_t *) PHYS_BASE - (i + 1) * PGSIZE;
+      return fnv ? hash_bytes (&page, sizeof page) : hash_page (page);
+    case KERNEL_FRAMES:
+      page = (void *) (0xc0100000 + i * 2 * PGSIZE);
+      return fnv ? hash_bytes (&page, sizeof page) : hash_page (page);
+    case INTS:
+      n = i;
+      return fnv ? hash_bytes (&n, sizeof n) : hash_int (n);
+    case STRIDED_INTS:
+      n = i * 1024;
+      return fnv ? hash_bytes (&n, sizeof n) : hash_int (n);
+    case NAMES:
+      return (fnv
+              ? hash_bytes (names[i], strlen (names[i]))
+              : hash_string (names[i]));
+    default:
+      NOT_REACHED ();
+    }
+}
+
+/* Returns the chi-squared statistic for the distribution of
+   HASHES[], shifted right by SHIFT bits, over M buckets, M a
+   power of 2.  For a uniform distribution, its expected value is
+   M - 1. */
+static unsigned
+chi_squared (const unsigned hashes[], int shift, size_t m)
+{
+  static unsigned counts[LOW_BUCKETS];
+  unsigned expected = KEY_CNT / m;
+  unsigned sum = 0;
+  size_t i;
+
+  memset (counts, 0, sizeof counts);
+  for (i = 0; i < KEY_CNT; i++)
+    counts[(hashes[i] >> shift) & (m - 1)]++;
+  for (i = 0; i < m; i++)
+    {
+      int d = counts[i] - expected;
+      sum += d * d;
+    }
+  return sum / expected;
+}
+
+/* Checks that hash_string() gives the same result for strings of
+   every length up to 16 at every alignment. */
+static void
+test_alignment (void)
+{
+  static char buf[32];
+  size_t len, ofs, i;
+
+  printf ("testing hash_string alignment:");
+  for (len = 0; len <= 16; len++)
+    {
+      unsigned hash = 0;
+
+      printf (" %zu", len);
+      for (ofs = 0; ofs < 8; ofs++)
+        {
+          /* Fill the whole buffer with random nonzero bytes, so
+             that bytes outside the string differ between
+             offsets. */
+          for (i = 0; i < sizeof buf; i++)
+            buf[i] = 1 + random_ulong () % 255;
+          for (i = 0; i < len; i++)
+            buf[ofs + i] = 'a' + i;
+          buf[ofs + len] = '\0';
+
+          if (ofs == 0)
+            hash = hash_string (buf);
+          else
+            ASSERT (hash_string (buf + ofs) == hash);
+        }
+    }
+  printf (" done\n");
+}
+
+/* Checks that seeds change hash_string_seeded()'s results. */
+static void
+test_seeds (void)
+{
+  size_t i, same = 0;
+
+  printf ("testing hash_string_seeded:");
+  ASSERT (hash_string_seeded ("file0", 0) == hash_string ("file0"));
+  for (i = 0; i < KEY_CNT; i++)
+    if (hash_string_seeded (names[i], 1) == hash_string_seeded (names[i], 2))
+      same++;
+  ASSERT (same < 4);
+  printf (" done\n");
+}
+
+/* Returns the CPU's time-stamp counter. */
+static uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
@@ -0,0 +1,277 @@
+/* Test program and micro-benchmark for lib/kernel/ohash.c.
+
+   Applies the same random sequence of insertions, replacements,
+   lookups, and deletions to an ohash and to a chained hash from
+   lib/kernel/hash.c and checks that they always agree, then
+   times the basic operations on both.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <hash.h>
+#include <inttypes.h>
+#include <ohash.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Number of distinct keys used by the random test. */
+#define KEY_CNT 512
+
+/* Number of random operations. */
+#define OP_CNT 50000
+
+/* Largest table benchmarked. */
+#define MAX_BENCH 16384
+
+/* An element that can be in both kinds of table at once. */
+struct value
+  {
+    struct hash_elem elem;      /* Chained hash element. */
+    struct ohash_elem oelem;    /* Open-addressing hash element. */
+    int key;                    /* Key. */
+    bool in_table;              /* In both tables? */
+  };
+
+static unsigned value_hash (const struct hash_elem *, void *);
+static bool value_less (const struct hash_elem *, const struct hash_elem *,
+                        void *);
+static unsigned value_ohash (const struct ohash_elem *, void *);
+static bool value_oless (const struct ohash_elem *, const struct ohash_elem *,
+                         void *);
+static void verify (struct ohash *, struct value[], size_t cnt);
+static void benchmark (size_t cnt);
+static uint64_t rdtsc (void);
+
+/* Test the open-addressing hash table implementation. */
+void
+test (void)
+{
+  static struct value values[KEY_CNT];
+  static struct value twins[KEY_CNT];
+  struct hash h;
+  struct ohash oh;
+  int i;
+
+  printf ("testing random operations:");
+  ASSERT (hash_init (&h, value_hash, value_less, NULL));
+  ASSERT (ohash_init (&oh, value_ohash, value_oless, NULL));
+  for (i = 0; i < KEY_CNT; i++)
+    {
+      values[i].key = twins[i].key = i * 7919;
+      values[i].in_table = false;
+    }
+
+  for (i = 0; i < OP_CNT; i++)
+    {
+      /* Bias toward insertions in the first half and deletions in
+         the second, so that the table grows and shrinks through
+         several resizes. */
+      int insert_pct = i < OP_CNT / 2 ? 60 : 5;
+      struct value *v = &values[random_ulong () % KEY_CNT];
+      struct value key;
+      int op = random_ulong () % 100;
+
+      key.key = v->key;
+      if (op < insert_pct)
+        {
+          struct hash_elem *e = hash_insert (&h, &v->elem);
+          struct ohash_elem *oe = ohash_insert (&oh, &v->oelem);
+          ASSERT ((e == NULL) == (oe == NULL));
+          ASSERT (oe == NULL || ohash_entry (oe, struct value, oelem) == v);
+          v->in_table = true;
+        }
+      else if (op < insert_pct + 5)
+        {
+          /* Replace V by its twin, then put V back. */
+          struct value *t = &twins[v - values];
+          struct ohash_elem *oe = ohash_replace (&oh, &t->oelem);
+          ASSERT (v->in_table
+                  ? oe != NULL && ohash_entry (oe, struct value, oelem) == v
+                  : oe == NULL);
+          oe = ohash_replace (&oh, &v->oelem);
+          ASSERT (oe != NULL && ohash_entry (oe, struct value, oelem) == t);
+          if (!v->in_table)
+            {
+              hash_insert (&h, &v->elem);
+              v->in_table = true;
+            }
+        }
+      else if (op < insert_pct + 25)
+        {
+          struct ohash_elem *oe = ohash_find (&oh, &key.oelem);
+          ASSERT ((hash_find (&h, &key.elem) != NULL) == (oe != NULL));
+          ASSERT (oe == NULL || ohash_entry (oe, struct value, oelem) == v);
+        }
+      else
+        {
+          struct hash_elem *e = hash_delete (&h, &key.elem);
+          struct ohash_elem *oe = ohash_delete (&oh, &key.oelem);
+          ASSERT ((e == NULL) == (oe == NULL));
+          ASSERT (oe == NULL || ohash_entry (oe, struct value, oelem) == v);
+          v->in_table = false;
+        }
+      ASSERT (hash_size (&h) == ohash_size (&oh));
+
+      if (i % (OP_CNT / 10) == 0)
+        {
+          printf (" %zu", ohash_size (&oh));
+          verify (&oh, values, KEY_CNT);
+        }
+    }
+  verify (&oh, values, KEY_CNT);
+
+  ohash_clear (&oh, NULL);
+  ASSERT (ohash_empty (&oh));
+  ohash_destroy (&oh, NULL);
+  hash_destroy (&h, NULL);
+  printf (" done\n");
+
+  printf ("benchmarking (cycles per operation, open addressing vs. chained):\n");
+  benchmark (64);
+  benchmark (1024);
+  benchmark (MAX_BENCH);
+
+  printf ("ohash: PASS\n");
+}
+
+/* Checks that iterating OH visits exactly the elements of
+   VALUES[] that are in the table, once each. */
+static void
+verify (struct ohash *oh, struct value values[], size_t cnt)
+{
+  static bool seen[KEY_CNT];
+  struct ohash_iterator i;
+  size_t j, visited = 0;
+
+  for (j = 0; j < cnt; j++)
+    seen[j] = false;
+
+  ohash_first (&i, oh);
+  while (ohash_next (&i))
+    {
+      struct value *v = ohash_entry (ohash_cur (&i), struct value, oelem);
+      j = v - values;
+      ASSERT (j < cnt && v->in_table && !seen[j]);
+      seen[j] = true;
+      visited++;
+    }
+  ASSERT (visited == ohash_size (oh));
+}
+
+/* Times insertion, successful and unsuccessful lookup, and
+   deletion of CNT elements in both kinds of table. */
+static void
+benchmark (size_t cnt)
+{
+  static struct value values[MAX_BENCH];
+  struct hash h;
+  struct ohash oh;
+  struct value key;
+  uint64_t t, o_ins, o_hit, o_miss, o_del, c_ins, c_hit, c_miss, c_del;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    values[i].key = random_ulong () & 0x7fffffff;
+
+  ASSERT (ohash_init (&oh, value_ohash, value_oless, NULL));
+  t = rdtsc ();
+  for (i = 0; i < cnt; i++)
+    ohash_insert (&oh, &values[i].oelem);
+  o_ins = rdtsc () - t;
+  t = rdtsc ();
+  for (i = 0; i < cnt; i++)
+    {
+      key.key = values[i].key;
+      ohash_find (&oh, &key.oelem);
+    }
+  o_hit = rdtsc () - t;
+  t = rdtsc ();
+  for (i = 0; i < cnt; i++)
+    {
+      key.key = -1 - (int) i;
+      ohash_find (&oh, &key.oelem);
+    }
+  o_miss = rdtsc () - t;
+  t = rdtsc ();
+  for (i = 0; i < cnt; i++)
+    ohash_delete (&oh, &values[i].oelem);
+  o_del = rdtsc () - t;
+  ohash_destroy (&oh, NULL);
+
+  ASSERT (hash_init (&h, value_hash, value_less, NULL));
+  t = rdtsc ();
+  for (i = 0; i < cnt; i++)
+    hash_insert (&h, &values[i].elem);
+  c_ins = rdtsc () - t;
+  t = rdtsc ();
+  for (i = 0; i < cnt; i++)
+    {
+      key.key = values[i].key;
+      hash_find (&h, &key.elem);
+    }
+  c_hit = rdtsc () - t;
+  t = rdtsc ();
+  for (i = 0; i < cnt; i++)
+    {
+      key.key = -1 - (int) i;
+      hash_find (&h, &key.elem);
+    }
+  c_miss = rdtsc () - t;
+  t = rdtsc ();
+  for (i = 0; i < cnt; i++)
+    hash_delete (&h, &values[i].elem);
+  c_del = rdtsc () - t;
+  hash_destroy (&h, NULL);
+
+  printf ("  %5zu elements: insert %4"PRIu64" vs. %4"PRIu64
+          ", hit %4"PRIu64" vs. %4"PRIu64
+          ", miss %4"PRIu64" vs. %4"PRIu64
+          ", delete %4"PRIu64" vs. %4"PRIu64"\n",
+          cnt, o_ins / cnt, c_ins / cnt, o_hit / cnt, c_hit / cnt,
+          o_miss / cnt, c_miss / cnt, o_del / cnt, c_del / cnt);
+}
+
+/* Returns a hash of the key in the value containing E. */
+static unsigned
+value_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct value, elem)->key);
+}
+
+/* Returns true if A's key is less than B's. */
+static bool
+value_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct value, elem)->key
+          < hash_entry (b, struct value, elem)->key);
+}
+
+/* Returns a hash of the key in the value containing E. */
+static unsigned
+value_ohash (const struct ohash_elem *e, void *aux UNUSED)
+{
+  return hash_int (ohash_entry (e, struct value, oelem)->key);
+}
+
+/* Returns true if A's key is less than B's. */
+static bool
+value_oless (const struct ohash_elem *a, const struct ohash_elem *b,
+             void *aux UNUSED)
+{
+  return (ohash_entry (a, struct value, oelem)->key
+          < ohash_entry (b, struct value, oelem)->key);
+}
+
+/* Returns the CPU's time-stamp counter. */
+static uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
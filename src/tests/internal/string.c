@@ -0,0 +1,308 @@
+/* Test program and micro-benchmark for the block and string
+   functions in lib/string.c.
+
+   Checks memcpy(), memmove(), memset(), memcmp(), and strlen()
+   against simple byte-at-a-time reference implementations at
+   every combination of small size and alignment, making sure
+   that no byte outside the destination is touched, then times
+   them against the references at 16, 512, and 4096 bytes.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/test.h"
+
+/* Largest block size checked at every alignment. */
+#define MAX_SIZE 200
+
+/* Buffer size, enough for the largest block plus slack on each
+   side. */
+#define BUF_SIZE 8192
+
+/* Number of calls timed for each benchmark. */
+#define CALL_CNT 256
+
+static uint8_t src_buf[BUF_SIZE], dst_buf[BUF_SIZE], ref_buf[BUF_SIZE];
+
+/* Results of timed calls, so that they are not optimized away. */
+static volatile int sink;
+
+static void fill_random (uint8_t *, size_t);
+static void test_copy (void);
+static void test_move (void);
+static void test_set (void);
+static void test_compare (void);
+static void test_strlen (void);
+static void benchmark (size_t size);
+static void *ref_memcpy (void *, const void *, size_t);
+static void *ref_memset (void *, int, size_t);
+static int ref_memcmp (const void *, const void *, size_t);
+static size_t ref_strlen (const char *);
+static int sign (int);
+static uint64_t rdtsc (void);
+
+/* Test the block and string functions. */
+void
+test (void)
+{
+  test_copy ();
+  test_move ();
+  test_set ();
+  test_compare ();
+  test_strlen ();
+
+  printf ("benchmarking (cycles per call, new vs. byte at a time):\n");
+  benchmark (16);
+  benchmark (512);
+  benchmark (4096);
+
+  printf ("string: PASS\n");
+}
+
+/* Checks memcpy() at every size up to MAX_SIZE and every source
+   and destination alignment, plus one big copy. */
+static void
+test_copy (void)
+{
+  size_t size, s_ofs, d_ofs;
+
+  printf ("testing memcpy:");
+  for (size = 0; size <= MAX_SIZE; size++)
+    for (s_ofs = 0; s_ofs < 4; s_ofs++)
+      for (d_ofs = 0; d_ofs < 4; d_ofs++)
+        {
+          fill_random (src_buf, 512);
+          fill_random (dst_buf, 512);
+          memcpy (ref_buf, dst_buf, 512);
+
+          ASSERT (memcpy (dst_buf + 16 + d_ofs, src_buf + 16 + s_ofs, size)
+                  == dst_buf + 16 + d_ofs);
+          ref_memcpy (ref_buf + 16 + d_ofs, src_buf + 16 + s_ofs, size);
+          ASSERT (ref_memcmp (dst_buf, ref_buf, 512) == 0);
+        }
+
+  fill_random (src_buf, BUF_SIZE);
+  memcpy (dst_buf + 1, src_buf + 3, BUF_SIZE - 3);
+  ASSERT (ref_memcmp (dst_buf + 1, src_buf + 3, BUF_SIZE - 3) == 0);
+  printf (" done\n");
+}
+
+/* Checks memmove() with overlapping blocks in both directions
+   at every size up to MAX_SIZE and every distance up to 8. */
+static void
+test_move (void)
+{
+  size_t size;
+  int dist;
+
+  printf ("testing memmove:");
+  for (size = 0; size <= MAX_SIZE; size++)
+    for (dist = -8; dist <= 8; dist++)
+      {
+        uint8_t *src = dst_buf + 64;
+        uint8_t *dst = src + dist;
+
+        fill_random (dst_buf, 512);
+        memcpy (ref_buf, dst_buf, 512);
+
+        /* Reference: copy through a separate buffer. */
+        ref_memcpy (src_buf, ref_buf + 64, size);
+        ref_memcpy (ref_buf + 64 + dist, src_buf, size);
+
+        ASSERT (memmove (dst, src, size) == dst);
+        ASSERT (ref_memcmp (dst_buf, ref_buf, 512) == 0);
+      }
+  printf (" done\n");
+}
+
+/* Checks memset() at every size up to MAX_SIZE and every
+   alignment. */
+static void
+test_set (void)
+{
+  size_t size, ofs;
+
+  printf ("testing memset:");
+  for (size = 0; size <= MAX_SIZE; size++)
+    for (ofs = 0; ofs < 4; ofs++)
+      {
+        int value = random_ulong ();
+
+        fill_random (dst_buf, 512);
+        memcpy (ref_buf, dst_buf, 512);
+
+        ASSERT (memset (dst_buf + 16 + ofs, value, size)
+                == dst_buf + 16 + ofs);
+        ref_memset (ref_buf + 16 + ofs, value, size);
+        ASSERT (ref_memcmp (dst_buf, ref_buf, 512) == 0);
+      }
+  printf (" done\n");
+}
+
+/* Checks memcmp() on blocks that are equal or differ in one
+   byte, at every size up to MAX_SIZE and every alignment. */
+static void
+test_compare (void)
+{
+  size_t size, a_ofs, b_ofs;
+
+  printf ("testing memcmp:");
+  for (size = 0; size <= MAX_SIZE; size++)
+    for (a_ofs = 0; a_ofs < 4; a_ofs++)
+      for (b_ofs = 0; b_ofs < 4; b_ofs++)
+        {
+          uint8_t *a = src_buf + a_ofs;
+          uint8_t *b = dst_buf + b_ofs;
+
+          fill_random (a, size);
+          ref_memcpy (b, a, size);
+          ASSERT (memcmp (a, b, size) == 0);
+
+          if (size > 0)
+            {
+              size_t i = random_ulong () % size;
+              b[i] = random_ulong ();
+              ASSERT (sign (memcmp (a, b, size))
+                      == sign (ref_memcmp (a, b, size)));
+            }
+        }
+  printf (" done\n");
+}
+
+/* Checks strlen() at every length up to MAX_SIZE and every
+   alignment. */
+static void
+test_strlen (void)
+{
+  size_t len, ofs, i;
+
+  printf ("testing strlen:");
+  for (len = 0; len <= MAX_SIZE; len++)
+    for (ofs = 0; ofs < 4; ofs++)
+      {
+        char *s = (char *) src_buf + ofs;
+
+        for (i = 0; i < len; i++)
+          s[i] = 1 + random_ulong () % 255;
+        s[len] = '\0';
+        s[len + 1] = random_ulong ();
+        ASSERT (strlen (s) == len);
+        ASSERT (ref_strlen (s) == len);
+      }
+  printf (" done\n");
+}
+
+/* Times CALL_CNT calls of each function on SIZE-byte blocks and
+   prints the average cycles per call for the library function
+   and for the reference. */
+static void
+benchmark (size_t size)
+{
+  uint64_t t, copy, ref_copy, set, ref_set, cmp, ref_cmp, len, ref_len;
+  int i;
+
+  /* SRC_BUF holds a string of SIZE - 1 bytes, and DST_BUF a copy
+     of it, so that memcmp() has to compare every byte. */
+  ref_memset (src_buf, 'x', size - 1);
+  src_buf[size - 1] = '\0';
+  ref_memcpy (dst_buf, src_buf, size);
+
+#define TIME(RESULT, CALL)                      \
+  t = rdtsc ();                                 \
+  for (i = 0; i < CALL_CNT; i++)                \
+    CALL;                                       \
+  RESULT = (rdtsc () - t) / CALL_CNT;
+
+  TIME (copy, memcpy (dst_buf, src_buf, size));
+  TIME (ref_copy, ref_memcpy (dst_buf, src_buf, size));
+  TIME (set, memset (ref_buf, 0, size));
+  TIME (ref_set, ref_memset (ref_buf, 0, size));
+  TIME (cmp, sink = memcmp (dst_buf, src_buf, size));
+  TIME (ref_cmp, sink = ref_memcmp (dst_buf, src_buf, size));
+  TIME (len, sink = strlen ((char *) src_buf));
+  TIME (ref_len, sink = ref_strlen ((char *) src_buf));
+#undef TIME
+
+  printf ("  %4zu bytes: memcpy %4"PRIu64" vs. %5"PRIu64
+          ", memset %4"PRIu64" vs. %5"PRIu64
+          ", memcmp %4"PRIu64" vs. %5"PRIu64
+          ", strlen %4"PRIu64" vs. %5"PRIu64"\n",
+          size, copy, ref_copy, set, ref_set, cmp, ref_cmp, len, ref_len);
+}
+
+/* Fills the SIZE bytes at P with random data. */
+static void
+fill_random (uint8_t *p, size_t size)
+{
+  random_bytes (p, size);
+}
+
+/* Reference memcpy(). */
+static void *
+ref_memcpy (void *dst_, const void *src_, size_t size)
+{
+  uint8_t *dst = dst_;
+  const uint8_t *src = src_;
+
+  while (size-- > 0)
+    *dst++ = *src++;
+  return dst_;
+}
+
+/* Reference memset(). */
+static void *
+ref_memset (void *dst_, int value, size_t size)
+{
+  uint8_t *dst = dst_;
+
+  while (size-- > 0)
+    *dst++ = value;
+  return dst_;
+}
+
+/* Reference memcmp(). */
+static int
+ref_memcmp (const void *a_, const void *b_, size_t size)
+{
+  const uint8_t *a = a_;
+  const uint8_t *b = b_;
+
+  for (; size-- > 0; a++, b++)
+    if (*a != *b)
+      return *a > *b ? +1 : -1;
+  return 0;
+}
+
+/* Reference strlen(). */
+static size_t
+ref_strlen (const char *s)
+{
+  const char *p;
+
+  for (p = s; *p != '\0'; p++)
+    continue;
+  return p - s;
+}
+
+/* Returns -1, 0, or +1 according to the sign of X. */
+static int
+sign (int x)
+{
+  return (x > 0) - (x < 0);
+}
+
+/* Returns the CPU's time-stamp counter. */
+static uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
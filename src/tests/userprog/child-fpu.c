@@ -0,0 +1,63 @@
+/* Child process run by fpu-parallel.
+   Unlike other test programs, built to use the FPU.  Sets the
+   x87 rounding mode given as its argument, then divides 1 by 3
+   over and over, checking each time that the result is the one
+   that rounding mode gives, while keeping a running sum in an
+   FPU register.  If the kernel let another process's FPU state
+   leak in across a context switch, the rounding mode or the sum
+   would change and the check would fail. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-fpu";
+
+/* x87 rounding modes, as set in the RC field of the control
+   word. */
+#define RC_DOWN 1
+#define RC_UP 2
+
+/* 1/3 as a double, rounded down and up. */
+#define THIRD_DOWN 0x3fd5555555555555ULL
+#define THIRD_UP 0x3fd5555555555556ULL
+
+#define ITERATIONS 1000000
+
+/* Sets the x87 rounding mode to RC. */
+static void
+set_rounding (unsigned rc)
+{
+  uint16_t cw;
+
+  asm volatile ("fnstcw %0" : "=m" (cw));
+  cw = (cw & ~0x0c00) | rc << 10;
+  asm volatile ("fldcw %0" : : "m" (cw));
+}
+
+int
+main (int argc, char *argv[])
+{
+  int rc = argc > 1 ? atoi (argv[1]) : RC_DOWN;
+  volatile double three = 3.0, quotient;
+  volatile union { double d; uint64_t u; } third;
+  double sum = 0.0;
+  int i;
+
+  set_rounding (rc);
+  third.d = 1.0 / three;
+  if (third.u != (rc == RC_UP ? THIRD_UP : THIRD_DOWN))
+    fail ("1/3 is %#llx after setting rounding mode %d", third.u, rc);
+
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      quotient = 1.0 / three;
+      if (quotient != third.d)
+        fail ("rounding mode changed after %d divisions", i);
+      sum += i;
+    }
+  if (sum != (double) ITERATIONS * (ITERATIONS - 1) / 2)
+    fail ("sum of 0...%d is wrong", ITERATIONS - 1);
+
+  return 0x42;
+}
@@ -0,0 +1,18 @@
+/* Runs two child-fpu processes at once, one rounding down and
+   one rounding up, to check that each keeps its own FPU state
+   across context switches. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  pid_t down, up;
+
+  CHECK ((down = exec ("child-fpu 1")) != -1, "exec \"child-fpu 1\"");
+  CHECK ((up = exec ("child-fpu 2")) != -1, "exec \"child-fpu 2\"");
+  CHECK (wait (down) == 0x42, "wait for child rounding down");
+  CHECK (wait (up) == 0x42, "wait for child rounding up");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fpu-parallel) begin
+(fpu-parallel) exec "child-fpu 1"
+(fpu-parallel) exec "child-fpu 2"
+(fpu-parallel) wait for child rounding down
+(fpu-parallel) wait for child rounding up
+(fpu-parallel) end
+EOF
+pass;
@@ -0,0 +1,75 @@
+/* Writes a file with writev() and reads it back with readv(),
+   using a different split of buffers each way.  The vectors
+   include an empty buffer and a buffer bigger than the kernel
+   pins at once, so that each call takes more than one batch. */
+
+#include <iovec.h>
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Size of the big buffer: more than the 256 kB that the kernel
+   pins at a time. */
+#define BIG_SIZE (300 * 1024)
+
+/* Size of each small buffer. */
+#define SMALL_SIZE 100
+
+/* Total bytes in the file. */
+#define FILE_SIZE (BIG_SIZE + 3 * SMALL_SIZE)
+
+static char big[BIG_SIZE];
+static char small[3][SMALL_SIZE];
+static char expected[FILE_SIZE];
+static char actual[FILE_SIZE];
+
+void
+test_main (void)
+{
+  struct iovec out[5], in[3];
+  int fd;
+
+  random_bytes (big, sizeof big);
+  random_bytes (small, sizeof small);
+
+  /* The file as writev() below should leave it. */
+  memcpy (expected, small[0], SMALL_SIZE);
+  memcpy (expected + SMALL_SIZE, big, BIG_SIZE);
+  memcpy (expected + SMALL_SIZE + BIG_SIZE, small[1], SMALL_SIZE);
+  memcpy (expected + 2 * SMALL_SIZE + BIG_SIZE, small[2], SMALL_SIZE);
+
+  CHECK (create ("data", FILE_SIZE), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+
+  out[0].iov_base = small[0];
+  out[0].iov_len = SMALL_SIZE;
+  out[1].iov_base = small[1];
+  out[1].iov_len = 0;
+  out[2].iov_base = big;
+  out[2].iov_len = BIG_SIZE;
+  out[3].iov_base = small[1];
+  out[3].iov_len = SMALL_SIZE;
+  out[4].iov_base = small[2];
+  out[4].iov_len = SMALL_SIZE;
+  CHECK (writev (fd, out, 5) == FILE_SIZE, "writev %d bytes", FILE_SIZE);
+
+  seek (fd, 0);
+  in[0].iov_base = actual;
+  in[0].iov_len = 150;
+  in[1].iov_base = actual + 150;
+  in[1].iov_len = BIG_SIZE;
+  in[2].iov_base = actual + 150 + BIG_SIZE;
+  in[2].iov_len = FILE_SIZE - 150 - BIG_SIZE;
+  CHECK (readv (fd, in, 3) == FILE_SIZE, "readv %d bytes", FILE_SIZE);
+  compare_bytes (actual, expected, FILE_SIZE, 0, "data");
+
+  /* At end of file, reads nothing. */
+  CHECK (readv (fd, in, 3) == 0, "readv at end of file");
+
+  /* A bad count is rejected. */
+  CHECK (readv (fd, in, -1) == -1, "readv with negative count");
+  CHECK (writev (fd, out, IOV_MAX + 1) == -1, "writev with too many buffers");
+  close (fd);
+}
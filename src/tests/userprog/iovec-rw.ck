@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(iovec-rw) begin
+(iovec-rw) create "data"
+(iovec-rw) open "data"
+(iovec-rw) writev 307500 bytes
+(iovec-rw) readv 307500 bytes
+(iovec-rw) readv at end of file
+(iovec-rw) readv with negative count
+(iovec-rw) writev with too many buffers
+(iovec-rw) end
+EOF
+pass;
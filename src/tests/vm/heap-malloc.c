@@ -0,0 +1,157 @@
+/* Exercises malloc(), calloc(), realloc(), and free() with a
+   random mix of small and page-sized blocks, checking that no
+   block's contents are disturbed by the others, and that
+   calloc() rejects sizes whose product overflows.  Then allocates
+   and fills 3 MB in big blocks, more than fits in memory at
+   once, frees them, and checks that the heap shrinks back to
+   where it started.  Repeating that several times would run out
+   of swap if the kernel leaked swap slots when the heap
+   shrinks. */
+
+#include <malloc.h>
+#include <random.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Blocks in the random test. */
+#define BLOCK_CNT 256
+
+/* Random operations. */
+#define OP_CNT 20000
+
+/* Big blocks per round, and their size. */
+#define BIG_CNT 12
+#define BIG_SIZE (256 * 1024)
+
+/* Rounds of big allocations. */
+#define ROUND_CNT 4
+
+static uint8_t *blocks[BLOCK_CNT];
+static size_t sizes[BLOCK_CNT];
+static uint8_t values[BLOCK_CNT];
+
+/* Returns a random block size, mostly small but sometimes a few
+   pages. */
+static size_t
+random_size (void)
+{
+  return 1 + random_ulong () % (random_ulong () % 8 ? 1100 : 20000);
+}
+
+/* Fails unless the first SIZE bytes of block I all hold its
+   value. */
+static void
+check_block (int i, size_t size)
+{
+  size_t j;
+
+  for (j = 0; j < size; j++)
+    if (blocks[i][j] != values[i])
+      fail ("block %d byte %zu is %d, expected %d",
+            i, j, blocks[i][j], values[i]);
+}
+
+static void
+random_test (void)
+{
+  int op, i;
+
+  msg ("random malloc/calloc/realloc/free");
+  for (op = 0; op < OP_CNT; op++)
+    {
+      i = random_ulong () % BLOCK_CNT;
+      if (blocks[i] == NULL)
+        {
+          bool zeroed = random_ulong () % 4 == 0;
+
+          sizes[i] = random_size ();
+          blocks[i] = zeroed ? calloc (sizes[i], 1) : malloc (sizes[i]);
+          if (blocks[i] == NULL)
+            fail ("allocating %zu bytes failed", sizes[i]);
+          if ((uintptr_t) blocks[i] % 8 != 0)
+            fail ("block %p is misaligned", blocks[i]);
+          if (zeroed)
+            {
+              values[i] = 0;
+              check_block (i, sizes[i]);
+            }
+          values[i] = random_ulong ();
+          memset (blocks[i], values[i], sizes[i]);
+        }
+      else if (random_ulong () % 3 == 0)
+        {
+          size_t new_size = random_size ();
+          size_t kept = new_size < sizes[i] ? new_size : sizes[i];
+          uint8_t *p = realloc (blocks[i], new_size);
+
+          if (p == NULL)
+            fail ("reallocating to %zu bytes failed", new_size);
+          blocks[i] = p;
+          check_block (i, kept);
+          memset (p, values[i], new_size);
+          sizes[i] = new_size;
+        }
+      else
+        {
+          check_block (i, sizes[i]);
+          free (blocks[i]);
+          blocks[i] = NULL;
+        }
+    }
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    if (blocks[i] != NULL)
+      {
+        check_block (i, sizes[i]);
+        free (blocks[i]);
+        blocks[i] = NULL;
+      }
+
+  /* 0x10001 * 0x10001 wraps to 0x20001, which is bigger than
+     either factor. */
+  if (calloc (0x10001, 0x10001) != NULL)
+    fail ("calloc (0x10001, 0x10001) didn't fail");
+  if (calloc (SIZE_MAX, 2) != NULL)
+    fail ("calloc (SIZE_MAX, 2) didn't fail");
+}
+
+static void
+big_test (void)
+{
+  static uint8_t *big[BIG_CNT];
+  void *start = sbrk (0);
+  int round, i;
+  size_t j;
+
+  msg ("big blocks, %d rounds", ROUND_CNT);
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      for (i = 0; i < BIG_CNT; i++)
+        {
+          big[i] = malloc (BIG_SIZE);
+          if (big[i] == NULL)
+            fail ("round %d: allocating big block %d failed", round, i);
+          memset (big[i], round + i, BIG_SIZE);
+        }
+      for (i = 0; i < BIG_CNT; i++)
+        {
+          for (j = 0; j < BIG_SIZE; j += 512)
+            if (big[i][j] != (uint8_t) (round + i))
+              fail ("round %d: big block %d byte %zu is wrong",
+                    round, i, j);
+          free (big[i]);
+        }
+      if (sbrk (0) != start)
+        fail ("round %d: heap did not shrink back", round);
+    }
+}
+
+void
+test_main (void)
+{
+  random_test ();
+  big_test ();
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(heap-malloc) begin
+(heap-malloc) random malloc/calloc/realloc/free
+(heap-malloc) big blocks, 4 rounds
+(heap-malloc) end
+EOF
+pass;
@@ -0,0 +1,56 @@
+/* Grows the heap with sbrk(), checks that the new memory reads
+   as zeros and holds what is written to it, then shrinks the
+   heap and grows it again and checks that the pages given back
+   come back zeroed.  Also checks that sbrk() refuses to shrink
+   the heap below its start. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 8
+
+static void
+check_bytes (const char *p, size_t size, char value)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != value)
+      fail ("byte %zu is %d, expected %d", i, p[i], value);
+}
+
+void
+test_main (void)
+{
+  char *start;
+  size_t size = PAGE_CNT * PAGE_SIZE + 100;
+  size_t i;
+
+  start = sbrk (0);
+  CHECK (start != (void *) -1, "sbrk (0)");
+  CHECK (sbrk (size) == start, "grow heap by %zu bytes", size);
+  CHECK (sbrk (0) == start + size, "break moved up");
+
+  msg ("check new heap is zeroed");
+  check_bytes (start, size, 0);
+  for (i = 0; i < size; i++)
+    start[i] = 'a' + i % 26;
+
+  CHECK (sbrk (-(intptr_t) (size - PAGE_SIZE)) == start + size,
+         "shrink heap to one page");
+  for (i = 0; i < PAGE_SIZE; i++)
+    if (start[i] != (char) ('a' + i % 26))
+      fail ("byte %zu changed by shrinking", i);
+
+  CHECK (sbrk (size - PAGE_SIZE) == start + PAGE_SIZE, "grow heap again");
+  msg ("check regrown pages are zeroed");
+  check_bytes (start + PAGE_SIZE, size - PAGE_SIZE, 0);
+
+  CHECK (sbrk (-(intptr_t) size - 1) == (void *) -1,
+         "shrink below heap start fails");
+  CHECK (sbrk (0) == start + size, "failed call leaves break alone");
+  CHECK (sbrk (-(intptr_t) size) == start + size, "free heap");
+}
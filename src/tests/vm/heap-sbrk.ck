@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(heap-sbrk) begin
+(heap-sbrk) sbrk (0)
+(heap-sbrk) grow heap by 32868 bytes
+(heap-sbrk) break moved up
+(heap-sbrk) check new heap is zeroed
+(heap-sbrk) shrink heap to one page
+(heap-sbrk) grow heap again
+(heap-sbrk) check regrown pages are zeroed
+(heap-sbrk) shrink below heap start fails
+(heap-sbrk) failed call leaves break alone
+(heap-sbrk) free heap
+(heap-sbrk) end
+EOF
+pass;
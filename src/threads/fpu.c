@@ -0,0 +1,247 @@
+#include "threads/fpu.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+
+#ifdef USERPROG
+/* Terminates the current user process with STATUS.  Defined in
+   userprog/syscall.c. */
+void exit (int status);
+#endif
+
+/* Lazy FPU context switching.
+
+   The kernel itself is compiled with -msoft-float and never
+   touches the FPU, so floating-point and SSE registers only
+   need to be preserved for user programs, and only for those
+   that actually use them.  Instead of saving and restoring the
+   FPU on every context switch, we set CR0.TS whenever a thread
+   other than the one whose state is loaded in the FPU is
+   switched in.  The first FPU instruction such a thread
+   executes raises #NM (Device Not Available), at which point
+   we save the previous owner's registers and load the current
+   thread's.  Threads that never use the FPU never pay for it.
+
+   See [IA32-v3a] 2.5 "Control Registers" and 13.4 "Designing OS
+   Facilities for Saving x87 FPU, SSE and Extended States on
+   Task or Context Switches". */
+
+/* CR0 bits. */
+#define CR0_MP 0x00000002       /* Monitor coprocessor. */
+#define CR0_EM 0x00000004       /* (Floating-point) Emulation. */
+#define CR0_TS 0x00000008       /* Task switched. */
+#define CR0_NE 0x00000020       /* Numeric error reporting via #MF. */
+
+/* CR4 bits. */
+#define CR4_OSFXSR 0x00000200   /* FXSAVE/FXRSTOR and SSE enabled. */
+#define CR4_OSXMMEXCPT 0x00000400 /* Unmasked SSE exceptions raise #XM. */
+
+/* CPUID leaf 1 EDX bits. */
+#define CPUID_FXSR (1u << 24)   /* FXSAVE/FXRSTOR supported. */
+#define CPUID_SSE (1u << 25)    /* SSE supported. */
+
+/* Saved FPU state.  The FXSAVE image is 512 bytes and must be
+   16-byte aligned; FNSAVE uses only the first 108 bytes. */
+struct fpu_state
+  {
+    uint8_t image[512];
+  }
+__attribute__ ((aligned (16)));
+
+/* Thread whose state is currently loaded in the FPU, or a null
+   pointer if none. */
+static struct thread *fpu_owner;
+
+/* True if the CPU supports FXSAVE/FXRSTOR; otherwise we fall
+   back to FNSAVE/FRSTOR, which do not cover SSE registers. */
+static bool have_fxsr;
+
+/* Initial FPU state given to a thread on its first FPU use. */
+static struct fpu_state initial_state;
+
+/* Number of #NM faults taken, i.e. lazy FPU state switches. */
+static long long fpu_switch_cnt;
+
+static intr_handler_func fpu_not_available;
+
+static inline uint32_t
+read_cr0 (void)
+{
+  uint32_t cr0;
+  asm volatile ("movl %%cr0, %0" : "=r" (cr0));
+  return cr0;
+}
+
+static inline void
+write_cr0 (uint32_t cr0)
+{
+  asm volatile ("movl %0, %%cr0" : : "r" (cr0) : "memory");
+}
+
+/* Clears CR0.TS, allowing FPU instructions to execute. */
+static inline void
+clts (void)
+{
+  asm volatile ("clts" : : : "memory");
+}
+
+/* Saves the FPU registers into S. */
+static void
+fpu_save (struct fpu_state *s)
+{
+  if (have_fxsr)
+    asm volatile ("fxsave %0" : "=m" (*s));
+  else
+    asm volatile ("fnsave %0; fwait" : "=m" (*s));
+}
+
+/* Loads the FPU registers from S. */
+static void
+fpu_restore (const struct fpu_state *s)
+{
+  if (have_fxsr)
+    asm volatile ("fxrstor %0" : : "m" (*s));
+  else
+    asm volatile ("frstor %0" : : "m" (*s));
+}
+
+/* Returns the FPU state area of thread T, which is aligned
+   within the block T->fpu points to. */
+static struct fpu_state *
+thread_fpu (struct thread *t)
+{
+  return (struct fpu_state *) (((uintptr_t) t->fpu + 15) & ~15u);
+}
+
+/* Enables the FPU, captures its initial state, and arranges for
+   lazy switching. */
+void
+fpu_init (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  have_fxsr = (edx & CPUID_FXSR) != 0;
+  if (have_fxsr)
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      cr4 |= CR4_OSFXSR;
+      if (edx & CPUID_SSE)
+        cr4 |= CR4_OSXMMEXCPT;
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4));
+    }
+
+  /* start.S turned on emulation so that stray FPU instructions
+     would trap.  Turn it off and let CR0.TS do that job. */
+  write_cr0 ((read_cr0 () & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE);
+  asm volatile ("fninit");
+  if (have_fxsr)
+    {
+      uint32_t mxcsr = 0x1f80;  /* All SSE exceptions masked. */
+      asm volatile ("ldmxcsr %0" : : "m" (mxcsr));
+    }
+  fpu_save (&initial_state);
+  write_cr0 (read_cr0 () | CR0_TS);
+
+  intr_register_int (7, 0, INTR_ON, fpu_not_available,
+                     "#NM Device Not Available Exception");
+}
+
+/* Called when thread T is switched in, with interrupts off.
+   Leaves the FPU usable only if it already holds T's state. */
+void
+fpu_switch (struct thread *t)
+{
+  uint32_t cr0 = read_cr0 ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t == fpu_owner)
+    {
+      if (cr0 & CR0_TS)
+        clts ();
+    }
+  else if (!(cr0 & CR0_TS))
+    write_cr0 (cr0 | CR0_TS);
+}
+
+/* Releases thread T's FPU state.  Called by T as it exits. */
+void
+fpu_thread_exit (struct thread *t)
+{
+  enum intr_level old_level = intr_disable ();
+  if (fpu_owner == t)
+    {
+      fpu_owner = NULL;
+      write_cr0 (read_cr0 () | CR0_TS);
+    }
+  intr_set_level (old_level);
+
+  free (t->fpu);
+  t->fpu = NULL;
+}
+
+/* Prints FPU statistics. */
+void
+fpu_print_stats (void)
+{
+  printf ("FPU: %lld lazy state switches\n", fpu_switch_cnt);
+}
+
+/* #NM handler.  The running thread tried to use the FPU while
+   CR0.TS was set, so its state is not loaded: save the current
+   owner's state and load ours. */
+static void
+fpu_not_available (struct intr_frame *f)
+{
+  struct thread *cur = thread_current ();
+  struct fpu_state *state;
+  enum intr_level old_level;
+
+  /* The kernel is built with -msoft-float, so an FPU instruction
+     in kernel mode is a bug. */
+  if (f->cs == SEL_KCSEG)
+    {
+      intr_dump_frame (f);
+      PANIC ("Kernel bug - FPU used in kernel");
+    }
+
+  /* Allocate a state area on first use.  malloc() may sleep, so
+     do this before turning interrupts off. */
+  if (cur->fpu == NULL)
+    {
+      cur->fpu = malloc (sizeof *state + 15);
+      if (cur->fpu == NULL)
+        {
+          /* Kill the process the same way as other fatal user
+             faults, so that its parent sees exit status -1. */
+          printf ("%s: out of memory for FPU state\n", thread_name ());
+#ifdef USERPROG
+          exit (-1);
+#else
+          thread_exit ();
+#endif
+        }
+      memcpy (thread_fpu (cur), &initial_state, sizeof *state);
+    }
+  state = thread_fpu (cur);
+
+  old_level = intr_disable ();
+  clts ();
+  if (fpu_owner != cur)
+    {
+      if (fpu_owner != NULL)
+        fpu_save (thread_fpu (fpu_owner));
+      fpu_restore (state);
+      fpu_owner = cur;
+      fpu_switch_cnt++;
+    }
+  intr_set_level (old_level);
+}
@@ -0,0 +1,11 @@
+#ifndef THREADS_FPU_H
+#define THREADS_FPU_H
+
+struct thread;
+
+void fpu_init (void);
+void fpu_switch (struct thread *);
+void fpu_thread_exit (struct thread *);
+void fpu_print_stats (void);
+
+#endif /* threads/fpu.h */
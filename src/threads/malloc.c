@@ -4,7 +4,9 @@
 #include <round.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -32,7 +34,19 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   If the kernel is built with MALLOC_TRACK defined, every block
+   is preceded by a struct track that records the "file:line"
+   of the malloc() call that allocated it and links it into a
+   list of live blocks, which malloc_print_stats() summarizes at
+   shutdown so that leaks show up in test runs. */
+
+#ifdef MALLOC_TRACK
+#undef malloc
+#undef calloc
+#undef realloc
+#endif
 
 /* Descriptor. */
 struct desc
@@ -40,7 +54,14 @@ struct desc
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
-    struct lock lock;           /* Lock. */
+    struct adaptive_lock lock;  /* Lock. */
+    char name[16];              /* Name of lock, for statistics. */
+
+    /* Statistics, protected by LOCK. */
+    size_t live_cnt;            /* Blocks allocated. */
+    size_t peak_cnt;            /* Maximum of live_cnt. */
+    size_t arena_cnt;           /* Arenas in use. */
+    size_t peak_arena_cnt;      /* Maximum of arena_cnt. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -64,6 +85,25 @@ struct block
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Big block statistics, protected by disabling interrupts. */
+static size_t big_cnt;          /* Big blocks allocated. */
+static size_t big_pages;        /* Pages in big blocks. */
+static size_t peak_big_pages;   /* Maximum of big_pages. */
+
+#ifdef MALLOC_TRACK
+/* Allocation record, just before each block handed out. */
+struct track
+  {
+    struct list_elem elem;      /* Element in live_blocks. */
+    const char *site;           /* "file:line" of allocation. */
+    size_t size;                /* Size requested. */
+  };
+
+/* All allocated blocks.  Protected by disabling interrupts. */
+static struct list live_blocks = LIST_INITIALIZER (live_blocks);
+#endif
+
+static void *do_malloc (size_t, const char *site);
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
 
@@ -80,7 +120,8 @@ malloc_init (void)
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
-      lock_init (&d->lock);
+      snprintf (d->name, sizeof d->name, "malloc-%zu", block_size);
+      adaptive_lock_init (&d->lock, d->name);
     }
 }
 
@@ -88,14 +129,19 @@ malloc_init (void)
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) 
+{
+  return do_malloc (size, "(unknown)");
+}
+
+/* Allocates a block of at least SIZE bytes from the arenas,
+   without any allocation record. */
+static void *
+block_alloc (size_t size) 
 {
   struct desc *d;
   struct block *b;
   struct arena *a;
-
-  /* A null pointer satisfies a request for 0 bytes. */
-  if (size == 0)
-    return NULL;
+  enum intr_level old_level;
 
   /* Find the smallest descriptor that satisfies a SIZE-byte
      request. */
@@ -116,10 +162,17 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = NULL;
       a->free_cnt = page_cnt;
+
+      old_level = intr_disable ();
+      big_cnt++;
+      big_pages += page_cnt;
+      if (big_pages > peak_big_pages)
+        peak_big_pages = big_pages;
+      intr_set_level (old_level);
       return a + 1;
     }
 
-  lock_acquire (&d->lock);
+  adaptive_lock_acquire (&d->lock);
 
   /* If the free list is empty, create a new arena. */
   if (list_empty (&d->free_list))
@@ -130,7 +183,7 @@ malloc (size_t size)
       a = palloc_get_page (0);
       if (a == NULL) 
         {
-          lock_release (&d->lock);
+          adaptive_lock_release (&d->lock);
           return NULL; 
         }
 
@@ -143,20 +196,55 @@ malloc (size_t size)
           struct block *b = arena_to_block (a, i);
           list_push_back (&d->free_list, &b->free_elem);
         }
+      if (++d->arena_cnt > d->peak_arena_cnt)
+        d->peak_arena_cnt = d->arena_cnt;
     }
 
   /* Get a block from free list and return it. */
   b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
   a = block_to_arena (b);
   a->free_cnt--;
-  lock_release (&d->lock);
+  if (++d->live_cnt > d->peak_cnt)
+    d->peak_cnt = d->live_cnt;
+  adaptive_lock_release (&d->lock);
   return b;
 }
 
-/* Allocates and return A times B bytes initialized to zeroes.
+/* Allocates and returns a block of at least SIZE bytes,
+   recording SITE as its origin in allocation-tracking mode.
    Returns a null pointer if memory is not available. */
-void *
-calloc (size_t a, size_t b) 
+static void *
+do_malloc (size_t size, const char *site UNUSED) 
+{
+#ifdef MALLOC_TRACK
+  struct track *t;
+  enum intr_level old_level;
+#endif
+
+  /* A null pointer satisfies a request for 0 bytes. */
+  if (size == 0)
+    return NULL;
+
+#ifdef MALLOC_TRACK
+  t = block_alloc (size + sizeof *t);
+  if (t == NULL)
+    return NULL;
+  t->site = site;
+  t->size = size;
+  old_level = intr_disable ();
+  list_push_back (&live_blocks, &t->elem);
+  intr_set_level (old_level);
+  return t + 1;
+#else
+  return block_alloc (size);
+#endif
+}
+
+/* Allocates and return A times B bytes initialized to zeroes,
+   recording SITE as its origin in allocation-tracking mode.
+   Returns a null pointer if memory is not available. */
+static void *
+do_calloc (size_t a, size_t b, const char *site) 
 {
   void *p;
   size_t size;
@@ -167,13 +255,21 @@ calloc (size_t a, size_t b)
     return NULL;
 
   /* Allocate and zero memory. */
-  p = malloc (size);
+  p = do_malloc (size, site);
   if (p != NULL)
     memset (p, 0, size);
 
   return p;
 }
 
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b) 
+{
+  return do_calloc (a, b, "(unknown)");
+}
+
 /* Returns the number of bytes allocated for BLOCK. */
 static size_t
 block_size (void *block) 
@@ -185,14 +281,28 @@ block_size (void *block)
   return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
 }
 
+/* Returns the number of bytes usable in P, which was returned
+   by malloc(). */
+static size_t
+usable_size (void *p) 
+{
+#ifdef MALLOC_TRACK
+  struct track *t = (struct track *) p - 1;
+  return block_size (t) - sizeof *t;
+#else
+  return block_size (p);
+#endif
+}
+
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
-   moving it in the process.
+   moving it in the process, recording SITE as the new block's
+   origin in allocation-tracking mode.
    If successful, returns the new block; on failure, returns a
    null pointer.
    A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
    A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
-void *
-realloc (void *old_block, size_t new_size) 
+static void *
+do_realloc (void *old_block, size_t new_size, const char *site) 
 {
   if (new_size == 0) 
     {
@@ -201,10 +311,10 @@ realloc (void *old_block, size_t new_size)
     }
   else 
     {
-      void *new_block = malloc (new_size);
+      void *new_block = do_malloc (new_size, site);
       if (old_block != NULL && new_block != NULL)
         {
-          size_t old_size = block_size (old_block);
+          size_t old_size = usable_size (old_block);
           size_t min_size = new_size < old_size ? new_size : old_size;
           memcpy (new_block, old_block, min_size);
           free (old_block);
@@ -213,11 +323,57 @@ realloc (void *old_block, size_t new_size)
     }
 }
 
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer.
+   A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size) 
+{
+  return do_realloc (old_block, new_size, "(unknown)");
+}
+
+#ifdef MALLOC_TRACK
+/* Versions of malloc(), calloc(), and realloc() that record
+   SITE as the origin of the new block.  malloc.h turns calls to
+   the plain functions into calls to these. */
+void *
+malloc_at (size_t size, const char *site) 
+{
+  return do_malloc (size, site);
+}
+
+void *
+calloc_at (size_t a, size_t b, const char *site) 
+{
+  return do_calloc (a, b, site);
+}
+
+void *
+realloc_at (void *old_block, size_t new_size, const char *site) 
+{
+  return do_realloc (old_block, new_size, site);
+}
+#endif
+
 /* Frees block P, which must have been previously allocated with
    malloc(), calloc(), or realloc(). */
 void
 free (void *p) 
 {
+#ifdef MALLOC_TRACK
+  if (p != NULL)
+    {
+      struct track *t = (struct track *) p - 1;
+      enum intr_level old_level = intr_disable ();
+      list_remove (&t->elem);
+      intr_set_level (old_level);
+      p = t;
+    }
+#endif
+
   if (p != NULL)
     {
       struct block *b = p;
@@ -233,10 +389,11 @@ free (void *p)
           memset (b, 0xcc, d->block_size);
 #endif
   
-          lock_acquire (&d->lock);
+          adaptive_lock_acquire (&d->lock);
 
           /* Add block to free list. */
           list_push_front (&d->free_list, &b->free_elem);
+          d->live_cnt--;
 
           /* If the arena is now entirely unused, free it. */
           if (++a->free_cnt >= d->blocks_per_arena) 
@@ -250,19 +407,116 @@ free (void *p)
                   list_remove (&b->free_elem);
                 }
               palloc_free_page (a);
+              d->arena_cnt--;
             }
 
-          lock_release (&d->lock);
+          adaptive_lock_release (&d->lock);
         }
       else
         {
           /* It's a big block.  Free its pages. */
+          enum intr_level old_level = intr_disable ();
+          big_cnt--;
+          big_pages -= a->free_cnt;
+          intr_set_level (old_level);
+
           palloc_free_multiple (a, a->free_cnt);
           return;
         }
     }
 }
 
+#ifdef MALLOC_TRACK
+/* Outstanding allocations from one site. */
+struct site_stats
+  {
+    const char *site;           /* "file:line". */
+    size_t cnt;                 /* Number of blocks. */
+    size_t bytes;               /* Total bytes requested. */
+  };
+
+/* Orders site_stats by decreasing bytes. */
+static int
+compare_site_stats (const void *a_, const void *b_)
+{
+  const struct site_stats *a = a_;
+  const struct site_stats *b = b_;
+  return a->bytes < b->bytes ? 1 : a->bytes > b->bytes ? -1 : 0;
+}
+
+/* Prints the blocks still allocated, grouped by the site that
+   allocated them, largest first. */
+static void
+print_live_blocks (void)
+{
+  enum { MAX_SITES = 64 };
+  static struct site_stats sites[MAX_SITES + 1];
+  size_t site_cnt = 0;
+  size_t i;
+  struct list_elem *e;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  for (e = list_begin (&live_blocks); e != list_end (&live_blocks);
+       e = list_next (e))
+    {
+      struct track *t = list_entry (e, struct track, elem);
+
+      /* Compare pointers, not strings: each site string is a
+         single literal. */
+      for (i = 0; i < site_cnt; i++)
+        if (sites[i].site == t->site)
+          break;
+      if (i == site_cnt)
+        {
+          if (site_cnt < MAX_SITES)
+            site_cnt++;
+          else
+            i = MAX_SITES;
+          sites[i].site = i < MAX_SITES ? t->site : "(other)";
+        }
+      sites[i].cnt++;
+      sites[i].bytes += t->size;
+    }
+  intr_set_level (old_level);
+  if (sites[MAX_SITES].cnt != 0)
+    site_cnt = MAX_SITES + 1;
+
+  qsort (sites, site_cnt, sizeof *sites, compare_site_stats);
+  printf ("Malloc: outstanding allocations by site:\n");
+  for (i = 0; i < site_cnt; i++)
+    printf ("  %8zu bytes in %5zu blocks from %s\n",
+            sites[i].bytes, sites[i].cnt, sites[i].site);
+}
+#endif
+
+/* Prints allocator statistics: for each block size, the blocks
+   in use and how full the arenas holding them are, and in
+   allocation-tracking mode the blocks still outstanding.  Takes
+   no locks, so that it is safe to call during shutdown. */
+void
+malloc_print_stats (void) 
+{
+  struct desc *d;
+
+  for (d = descs; d < descs + desc_cnt; d++)
+    {
+      size_t capacity = d->arena_cnt * d->blocks_per_arena;
+
+      if (d->peak_cnt != 0)
+        printf ("Malloc: %4zu-byte blocks: %zu live (peak %zu), "
+                "%zu arenas (peak %zu), %zu%% utilized\n",
+                d->block_size, d->live_cnt, d->peak_cnt,
+                d->arena_cnt, d->peak_arena_cnt,
+                capacity != 0 ? d->live_cnt * 100 / capacity : 100);
+    }
+  printf ("Malloc: big blocks: %zu live, %zu pages (peak %zu)\n",
+          big_cnt, big_pages, peak_big_pages);
+#ifdef MALLOC_TRACK
+  print_live_blocks ();
+#endif
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
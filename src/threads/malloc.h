@@ -9,5 +9,21 @@ void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
+void malloc_print_stats (void);
+
+#ifdef MALLOC_TRACK
+/* In allocation-tracking mode every block records the source
+   location that allocated it, and blocks still allocated at
+   shutdown are reported by malloc_print_stats(). */
+#define MALLOC_STR(X) MALLOC_STR_(X)
+#define MALLOC_STR_(X) #X
+#define MALLOC_SITE __FILE__ ":" MALLOC_STR (__LINE__)
+#define malloc(SIZE) malloc_at (SIZE, MALLOC_SITE)
+#define calloc(A, B) calloc_at (A, B, MALLOC_SITE)
+#define realloc(BLOCK, SIZE) realloc_at (BLOCK, SIZE, MALLOC_SITE)
+void *malloc_at (size_t, const char *site) __attribute__ ((malloc));
+void *calloc_at (size_t, size_t, const char *site) __attribute__ ((malloc));
+void *realloc_at (void *, size_t, const char *site);
+#endif
 
 #endif /* threads/malloc.h */
@@ -2,13 +2,14 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
-#include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -23,14 +24,82 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is managed as a binary buddy system.  Free memory is
+   kept as blocks of 2**ORDER pages, aligned to their size
+   relative to the pool base, on one free list per order.  An
+   allocation takes the smallest block that fits, splitting
+   larger blocks as needed, and a freed block is merged with its
+   "buddy" (the other half of the block it was split from)
+   whenever the buddy is also free.  Both take O(log n) time, so
+   allocation and freeing are cheap enough to do with interrupts
+   disabled.
+
+   A request for a page count that is not a power of 2 takes
+   the next larger block and immediately gives back the unused
+   tail, so callers always free exactly what they allocated.
+
+   Most requests are for a single page, so each pool also keeps
+   a "magazine", a small LIFO stack of free pages in front of
+   the buddy system.  Single-page requests are satisfied from
+   the top of the magazine, which is refilled from the buddy
+   system MAG_BATCH pages at a time when it runs dry, and freed
+   pages are pushed back onto it, with the oldest MAG_BATCH
+   pages drained back to the buddy system when it overflows.
+   Recently freed pages are thus reused while they are still in
+   the cache.
+
+   Finally, each pool keeps up to ZERO_TARGET pages that the
+   idle thread has already filled with zeros, for PAL_ZERO
+   requests.  All of these pages are still available to any
+   request: they are given back to the buddy system when a
+   multi-page request cannot otherwise be satisfied. */
+
+/* Number of block orders.  2**(BUDDY_ORDERS - 1) pages covers
+   the largest pool that fits in the 1 GB kernel address space. */
+#define BUDDY_ORDERS 19
+
+/* Value of free_order[] for a page that does not start a free
+   block. */
+#define NOT_FREE 0xff
+
+/* Magazine capacity and the number of pages moved to or from
+   the buddy system at a time. */
+#define MAG_SIZE 32
+#define MAG_BATCH (MAG_SIZE / 2)
+
+/* Number of pre-zeroed pages the idle thread keeps per pool. */
+#define ZERO_TARGET 16
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
+    const char *name;                   /* Name, for diagnostics. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
+    uint8_t *free_order;                /* Per page: order or NOT_FREE. */
     uint8_t *base;                      /* Base of pool. */
+    struct list free_lists[BUDDY_ORDERS]; /* Free blocks by order. */
+    size_t free_cnt[BUDDY_ORDERS];      /* Length of each free list. */
+
+    /* Page caches.  Pages in these are free but are neither in
+       a buddy free list nor marked in used_map. */
+    void *magazine[MAG_SIZE];           /* Recently freed pages. */
+    size_t mag_cnt;                     /* Number of pages in magazine. */
+    void *zero_pages[ZERO_TARGET];      /* Pre-zeroed pages. */
+    size_t zero_cnt;                    /* Number of pre-zeroed pages. */
+
+    /* Statistics. */
+    long long mag_hit_cnt;              /* Pages served from magazine. */
+    long long refill_cnt;               /* Magazine refills. */
+    long long drain_cnt;                /* Magazine drains. */
+    long long zero_hit_cnt;             /* Pre-zeroed pages used. */
+  };
+
+/* A free block.  Lives in the first page of the block itself. */
+struct free_block
+  {
+    struct list_elem elem;              /* Element in a free list. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -39,6 +108,11 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
+static void *cache_get (struct pool *, bool zero, bool *zeroed);
+static void cache_put (struct pool *, void *page);
+static void cache_drain_all (struct pool *);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -72,23 +146,38 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
   void *pages;
-  size_t page_idx;
+  bool zeroed = false;
+  enum intr_level old_level;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
-
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
+  old_level = intr_disable ();
+  if (page_cnt == 1)
+    pages = cache_get (pool, (flags & PAL_ZERO) != 0, &zeroed);
   else
-    pages = NULL;
+    {
+      size_t page_idx = buddy_alloc (pool, page_cnt);
+      if (page_idx == BITMAP_ERROR)
+        {
+          /* Give the cached pages back and try again. */
+          cache_drain_all (pool);
+          page_idx = buddy_alloc (pool, page_cnt);
+        }
+      pages = (page_idx != BITMAP_ERROR
+               ? pool->base + PGSIZE * page_idx : NULL);
+    }
+  if (pages != NULL)
+    {
+      size_t page_idx = pg_no (pages) - pg_no (pool->base);
+      ASSERT (bitmap_none (pool->used_map, page_idx, page_cnt));
+      bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+    }
+  intr_set_level (old_level);
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      if ((flags & PAL_ZERO) && !zeroed)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else 
@@ -119,6 +208,7 @@ palloc_free_multiple (void *pages, size_t page_cnt)
 {
   struct pool *pool;
   size_t page_idx;
+  enum intr_level old_level;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
@@ -137,8 +227,14 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  old_level = intr_disable ();
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  if (page_cnt == 1)
+    cache_put (pool, pages);
+  else
+    buddy_free (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -148,15 +244,94 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Zeroes one free page, if any pool is short of pre-zeroed
+   pages, and adds it to that pool's pre-zeroed pages.  Returns
+   true if a page was zeroed, false if there was nothing to do.
+   Called by the idle thread, so that PAL_ZERO requests do not
+   have to pay for zeroing. */
+bool
+palloc_prezero (void)
+{
+  struct pool *pools[] = {&kernel_pool, &user_pool};
+  size_t i;
+
+  for (i = 0; i < sizeof pools / sizeof *pools; i++)
+    {
+      struct pool *pool = pools[i];
+      enum intr_level old_level;
+      size_t page_idx;
+      void *page;
+
+      /* Take a page, preferring the buddy system so as to leave
+         the recently used pages in the magazine alone. */
+      old_level = intr_disable ();
+      page = NULL;
+      if (pool->zero_cnt < ZERO_TARGET)
+        {
+          page_idx = buddy_alloc (pool, 1);
+          if (page_idx != BITMAP_ERROR)
+            page = pool->base + PGSIZE * page_idx;
+          else if (pool->mag_cnt > 0)
+            page = pool->magazine[--pool->mag_cnt];
+        }
+      intr_set_level (old_level);
+      if (page == NULL)
+        continue;
+
+      memset (page, 0, PGSIZE);
+
+      old_level = intr_disable ();
+      if (pool->zero_cnt < ZERO_TARGET)
+        pool->zero_pages[pool->zero_cnt++] = page;
+      else
+        cache_put (pool, page);
+      intr_set_level (old_level);
+      return true;
+    }
+  return false;
+}
+
+/* Prints the free block counts of POOL, by order, and its page
+   cache statistics. */
+static void
+print_pool_stats (const struct pool *pool)
+{
+  size_t free_pages = pool->mag_cnt + pool->zero_cnt;
+  int order;
+
+  for (order = 0; order < BUDDY_ORDERS; order++)
+    free_pages += pool->free_cnt[order] << order;
+  printf ("Palloc: %s: %zu of %zu pages free; free blocks by order:",
+          pool->name, free_pages, bitmap_size (pool->used_map));
+  for (order = 0; order < BUDDY_ORDERS; order++)
+    if (pool->free_cnt[order] != 0)
+      printf (" %d:%zu", order, pool->free_cnt[order]);
+  printf ("\n");
+  printf ("Palloc: %s: %lld magazine hits, %lld refills, %lld drains, "
+          "%lld pre-zeroed pages used\n", pool->name, pool->mag_hit_cnt,
+          pool->refill_cnt, pool->drain_cnt, pool->zero_hit_cnt);
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void)
+{
+  print_pool_stats (&kernel_pool);
+  print_pool_stats (&user_pool);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  /* We'll put the pool's used_map and free_order array at its
+     base.  Calculate the space needed for them and subtract it
+     from the pool's size. */
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size + page_cnt, PGSIZE);
+  int order;
+
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -164,9 +339,212 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  p->name = name;
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->free_order = (uint8_t *) base + bm_size;
+  memset (p->free_order, NOT_FREE, page_cnt);
   p->base = base + bm_pages * PGSIZE;
+  for (order = 0; order < BUDDY_ORDERS; order++)
+    {
+      list_init (&p->free_lists[order]);
+      p->free_cnt[order] = 0;
+    }
+
+  p->mag_cnt = p->zero_cnt = 0;
+  p->mag_hit_cnt = p->refill_cnt = p->drain_cnt = p->zero_hit_cnt = 0;
+
+  /* Hand all of the pool's pages to the buddy system. */
+  buddy_free (p, 0, page_cnt);
+}
+
+/* Removes and returns a free page from POOL's caches, refilling
+   the magazine from the buddy system if it is empty, or returns
+   a null pointer if POOL has no free pages at all.  If ZERO is
+   true, a pre-zeroed page is preferred.  Sets *ZEROED to true
+   if the page returned is known to be zeroed.  Interrupts must
+   be off. */
+static void *
+cache_get (struct pool *pool, bool zero, bool *zeroed)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (zero && pool->zero_cnt > 0)
+    {
+      *zeroed = true;
+      pool->zero_hit_cnt++;
+      return pool->zero_pages[--pool->zero_cnt];
+    }
+
+  if (pool->mag_cnt > 0)
+    pool->mag_hit_cnt++;
+  else
+    {
+      /* Refill. */
+      while (pool->mag_cnt < MAG_BATCH)
+        {
+          size_t page_idx = buddy_alloc (pool, 1);
+          if (page_idx == BITMAP_ERROR)
+            break;
+          pool->magazine[pool->mag_cnt++] = pool->base + PGSIZE * page_idx;
+        }
+      pool->refill_cnt++;
+    }
+  if (pool->mag_cnt > 0)
+    return pool->magazine[--pool->mag_cnt];
+
+  /* Last resort. */
+  if (pool->zero_cnt > 0)
+    {
+      *zeroed = true;
+      pool->zero_hit_cnt++;
+      return pool->zero_pages[--pool->zero_cnt];
+    }
+  return NULL;
+}
+
+/* Pushes free PAGE onto POOL's magazine, first draining the
+   oldest MAG_BATCH pages back to the buddy system if the
+   magazine is full.  Interrupts must be off. */
+static void
+cache_put (struct pool *pool, void *page)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (pool->mag_cnt == MAG_SIZE)
+    {
+      size_t i;
+      for (i = 0; i < MAG_BATCH; i++)
+        buddy_free (pool, pg_no (pool->magazine[i]) - pg_no (pool->base), 1);
+      memmove (pool->magazine, pool->magazine + MAG_BATCH,
+               sizeof *pool->magazine * (MAG_SIZE - MAG_BATCH));
+      pool->mag_cnt -= MAG_BATCH;
+      pool->drain_cnt++;
+    }
+  pool->magazine[pool->mag_cnt++] = page;
+}
+
+/* Returns every page in POOL's caches to the buddy system.
+   Interrupts must be off. */
+static void
+cache_drain_all (struct pool *pool)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (pool->mag_cnt > 0)
+    buddy_free (pool, pg_no (pool->magazine[--pool->mag_cnt])
+                - pg_no (pool->base), 1);
+  while (pool->zero_cnt > 0)
+    buddy_free (pool, pg_no (pool->zero_pages[--pool->zero_cnt])
+                - pg_no (pool->base), 1);
+}
+
+/* Returns the free block header at page PAGE_IDX of POOL. */
+static struct free_block *
+block_at (const struct pool *pool, size_t page_idx)
+{
+  return (struct free_block *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Adds the block of 2**ORDER pages at PAGE_IDX in POOL to the
+   free list for ORDER. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order)
+{
+  list_push_front (&pool->free_lists[order],
+                   &block_at (pool, page_idx)->elem);
+  pool->free_order[page_idx] = order;
+  pool->free_cnt[order]++;
+}
+
+/* Removes the free block at PAGE_IDX in POOL, of the given
+   ORDER, from its free list. */
+static void
+remove_block (struct pool *pool, size_t page_idx, int order)
+{
+  ASSERT (pool->free_order[page_idx] == order);
+  list_remove (&block_at (pool, page_idx)->elem);
+  pool->free_order[page_idx] = NOT_FREE;
+  pool->free_cnt[order]--;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX in POOL,
+   merging it with its buddy as long as the buddy is free. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order)
+{
+  while (order < BUDDY_ORDERS - 1)
+    {
+      size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+      if (buddy_idx >= bitmap_size (pool->used_map)
+          || pool->free_order[buddy_idx] != order)
+        break;
+      remove_block (pool, buddy_idx, order);
+      if (buddy_idx < page_idx)
+        page_idx = buddy_idx;
+      order++;
+    }
+  push_block (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in POOL, which
+   need not form a single block, by splitting them into the
+   largest aligned blocks possible. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (page_cnt > 0)
+    {
+      int order = 0;
+      while (order < BUDDY_ORDERS - 1
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first one, or BITMAP_ERROR if no free block is
+   large enough. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt)
+{
+  int want, order;
+  size_t page_idx;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Find the smallest order that is large enough, then the
+     smallest nonempty free list at or above it. */
+  for (want = 0; ((size_t) 1 << want) < page_cnt; want++)
+    if (want == BUDDY_ORDERS - 1)
+      return BITMAP_ERROR;
+  for (order = want; order < BUDDY_ORDERS; order++)
+    if (pool->free_cnt[order] != 0)
+      break;
+  if (order == BUDDY_ORDERS)
+    return BITMAP_ERROR;
+
+  page_idx = (pg_no (list_entry (list_front (&pool->free_lists[order]),
+                                 struct free_block, elem))
+              - pg_no (pool->base));
+  remove_block (pool, page_idx, order);
+
+  /* Split the block down to the order we want, freeing the
+     upper half each time. */
+  while (order > want)
+    {
+      order--;
+      push_block (pool, page_idx + ((size_t) 1 << order), order);
+    }
+
+  /* Give back the pages past PAGE_CNT. */
+  buddy_free (pool, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+  return page_idx;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -0,0 +1,270 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator.
+
+   malloc() rounds every request up to a power of 2, so a
+   structure a little larger than a power of 2 wastes nearly
+   half of its block.  An object cache instead carves pages
+   ("slabs") into objects of exactly one size, so that only the
+   tail of each page is wasted.
+
+   Each slab is a single page from the kernel pool with a
+   struct slab header at its start, followed by an array of
+   free-list links, one per object, followed by the objects
+   themselves.  Keeping the links outside the objects means
+   that an object's contents survive being freed, so a
+   constructor needs to run only once per object, when its
+   slab is created, rather than on every allocation.
+
+   A cache keeps its slabs on three lists: full slabs, partial
+   slabs that have both free and allocated objects, and empty
+   slabs.  Allocation prefers partial slabs, to keep the number
+   of pages in use down, then empty ones, and allocates a new
+   slab only if there is neither.  At most one empty slab per
+   cache is kept around; others are returned to the page
+   allocator as soon as they become empty.
+
+   Allocation and freeing take constant time, so they are done
+   with interrupts disabled and may be called from any
+   context. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Free-list link value marking the end of a slab's free list. */
+#define SLAB_END UINT16_MAX
+
+/* An object cache. */
+struct kmem_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Object size, rounded for alignment. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    size_t objs_ofs;            /* Offset of first object in slab. */
+    kmem_ctor_func *ctor;       /* Constructor, or null. */
+    struct list full;           /* Slabs with no free objects. */
+    struct list partial;        /* Slabs with free and used objects. */
+    struct list empty;          /* Slabs with no used objects. */
+    struct list_elem elem;      /* Element in `caches'. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Slabs currently owned. */
+    size_t in_use;              /* Objects currently allocated. */
+    size_t peak_in_use;         /* Maximum of in_use. */
+    long long alloc_cnt;        /* Allocations. */
+    long long grow_cnt;         /* Slabs created. */
+    long long reap_cnt;         /* Slabs returned to palloc. */
+  };
+
+/* A slab, at the start of its page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in one of cache's lists. */
+    size_t in_use;              /* Number of allocated objects. */
+    uint16_t free;              /* Index of first free object. */
+    uint16_t next[];            /* Per object: index of next free. */
+  };
+
+/* All caches, for statistics. */
+static struct list caches = LIST_INITIALIZER (caches);
+
+/* Returns object IDX in slab S. */
+static void *
+slab_obj (struct slab *s, size_t idx)
+{
+  return (uint8_t *) s + s->cache->objs_ofs + idx * s->cache->obj_size;
+}
+
+/* Creates and returns a cache of objects of SIZE bytes, named
+   NAME for statistics.  If CTOR is nonnull, it is run on each
+   object when the slab containing it is created.  Returns a
+   null pointer if memory is not available. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor_func *ctor)
+{
+  struct kmem_cache *c;
+  size_t hdr;
+  enum intr_level old_level;
+
+  ASSERT (size > 0);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    return NULL;
+
+  /* Find how many objects fit in a page along with the header
+     and one link per object. */
+  c->name = name;
+  c->obj_size = ROUND_UP (size, sizeof (void *));
+  c->objs_per_slab = ((PGSIZE - sizeof (struct slab))
+                      / (c->obj_size + sizeof (uint16_t)));
+  if (c->objs_per_slab >= SLAB_END)
+    c->objs_per_slab = SLAB_END - 1;
+  ASSERT (c->objs_per_slab > 0);
+  hdr = sizeof (struct slab) + c->objs_per_slab * sizeof (uint16_t);
+  c->objs_ofs = ROUND_UP (hdr, sizeof (void *));
+  if (c->objs_ofs + c->objs_per_slab * c->obj_size > PGSIZE)
+    c->objs_per_slab--;
+  ASSERT (c->objs_per_slab > 0);
+
+  c->ctor = ctor;
+  list_init (&c->full);
+  list_init (&c->partial);
+  list_init (&c->empty);
+  c->slab_cnt = c->in_use = c->peak_in_use = 0;
+  c->alloc_cnt = c->grow_cnt = c->reap_cnt = 0;
+
+  old_level = intr_disable ();
+  list_push_back (&caches, &c->elem);
+  intr_set_level (old_level);
+
+  return c;
+}
+
+/* Obtains a new empty slab for cache C, with every object
+   constructed, and adds it to C's empty list.  Returns false
+   if no page is available.  Interrupts must be off. */
+static bool
+cache_grow (struct kmem_cache *c)
+{
+  struct slab *s;
+  size_t i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return false;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->in_use = 0;
+  s->free = 0;
+  for (i = 0; i < c->objs_per_slab; i++)
+    {
+      s->next[i] = i + 1 < c->objs_per_slab ? i + 1 : SLAB_END;
+      if (c->ctor != NULL)
+        c->ctor (slab_obj (s, i));
+    }
+  list_push_back (&c->empty, &s->elem);
+  c->slab_cnt++;
+  c->grow_cnt++;
+  return true;
+}
+
+/* Allocates and returns an object from cache C, or a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+  enum intr_level old_level;
+
+  ASSERT (c != NULL);
+
+  old_level = intr_disable ();
+  if (!list_empty (&c->partial))
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+  else if (!list_empty (&c->empty) || cache_grow (c))
+    s = list_entry (list_front (&c->empty), struct slab, elem);
+  else
+    {
+      intr_set_level (old_level);
+      return NULL;
+    }
+  ASSERT (s->free != SLAB_END);
+
+  obj = slab_obj (s, s->free);
+  s->free = s->next[s->free];
+  if (s->in_use++ == 0 || s->free == SLAB_END)
+    {
+      /* Move from empty to partial, or from partial (or, for
+         one-object slabs, empty) to full. */
+      list_remove (&s->elem);
+      list_push_front (s->free == SLAB_END ? &c->full : &c->partial,
+                       &s->elem);
+    }
+
+  c->alloc_cnt++;
+  if (++c->in_use > c->peak_in_use)
+    c->peak_in_use = c->in_use;
+  intr_set_level (old_level);
+
+  return obj;
+}
+
+/* Frees OBJ, which must have been allocated from cache C.  OBJ
+   should be in its constructed state, if C has a constructor. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+  size_t idx;
+  enum intr_level old_level;
+
+  if (obj == NULL)
+    return;
+
+  s = pg_round_down (obj);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+  idx = ((uint8_t *) obj - (uint8_t *) slab_obj (s, 0)) / c->obj_size;
+  ASSERT (obj == slab_obj (s, idx));
+  ASSERT (idx < c->objs_per_slab);
+
+  old_level = intr_disable ();
+  ASSERT (s->in_use > 0);
+  s->next[idx] = s->free;
+  s->free = idx;
+  c->in_use--;
+  if (--s->in_use == 0)
+    {
+      list_remove (&s->elem);
+      if (list_empty (&c->empty))
+        list_push_front (&c->empty, &s->elem);
+      else
+        {
+          /* Already have a spare empty slab. */
+          s->magic = 0;
+          c->slab_cnt--;
+          c->reap_cnt++;
+          palloc_free_page (s);
+        }
+    }
+  else if (s->in_use == c->objs_per_slab - 1)
+    {
+      /* Was full. */
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  intr_set_level (old_level);
+}
+
+/* Prints statistics for every object cache. */
+void
+kmem_cache_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&caches); e != list_end (&caches); e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      printf ("Slab: %s: %zu-byte objects, %zu per slab, %zu slabs, "
+              "%zu in use (peak %zu), %lld allocs, %lld grows, %lld reaps\n",
+              c->name, c->obj_size, c->objs_per_slab, c->slab_cnt,
+              c->in_use, c->peak_in_use, c->alloc_cnt, c->grow_cnt,
+              c->reap_cnt);
+    }
+}
@@ -28,10 +28,23 @@
 
 #include "threads/synch.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include "devices/timer.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+#ifdef LOCK_PROFILE
+/* synch.h turns lock_init() into a macro that records where it
+   was called from.  This file defines the function itself. */
+#undef lock_init
+
+static struct lock_class *lock_class_lookup (const char *name);
+static void lock_profile_acquired (struct lock *, bool contended,
+                                   int64_t wait);
+static void lock_profile_released (struct lock *);
+#endif
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -196,6 +209,37 @@ lock_init (struct lock *lock)
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+#ifdef LOCK_PROFILE
+  lock->class = lock_class_lookup ("(unnamed)");
+  lock->acquire_time = 0;
+#endif
+}
+
+#ifdef LOCK_PROFILE
+/* Initializes LOCK and accounts it to the lock class NAME.
+   The lock_init() macro in synch.h calls this with the
+   initializing source line as NAME. */
+void
+lock_init_named (struct lock *lock, const char *name)
+{
+  lock_init (lock);
+  lock_set_name (lock, name);
+}
+#endif
+
+/* Names LOCK for lock contention profiling, so that it is
+   reported separately from other locks initialized at the same
+   place.  NAME must remain valid for the life of the kernel.
+   Has no effect unless the kernel is built with LOCK_PROFILE. */
+void
+lock_set_name (struct lock *lock, const char *name UNUSED)
+{
+  ASSERT (lock != NULL);
+  ASSERT (name != NULL);
+
+#ifdef LOCK_PROFILE
+  lock->class = lock_class_lookup (name);
+#endif
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -213,8 +257,19 @@ lock_acquire (struct lock *lock)
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+#ifdef LOCK_PROFILE
+  {
+    int64_t start = timer_ticks ();
+    bool contended = lock->semaphore.value == 0;
+
+    sema_down (&lock->semaphore);
+    lock->holder = thread_current ();
+    lock_profile_acquired (lock, contended, timer_ticks () - start);
+  }
+#else
   sema_down (&lock->semaphore);
   lock->holder = thread_current ();
+#endif
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -233,7 +288,12 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      lock->holder = thread_current ();
+#ifdef LOCK_PROFILE
+      lock_profile_acquired (lock, false, 0);
+#endif
+    }
   return success;
 }
 
@@ -248,6 +308,9 @@ lock_release (struct lock *lock)
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+#ifdef LOCK_PROFILE
+  lock_profile_released (lock);
+#endif
   lock->holder = NULL;
   sema_up (&lock->semaphore);
 }
@@ -263,6 +326,169 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
+/* Number of times an adaptive lock yields to a ready holder
+   before it gives up and sleeps. */
+#define ADAPTIVE_SPIN_LIMIT 8
+
+/* Adaptive locks that were given a name, for reporting. */
+static struct list adaptive_locks = LIST_INITIALIZER (adaptive_locks);
+
+/* Initializes adaptive lock AL.  If NAME is non-null, AL is
+   registered under that name and reported by
+   adaptive_lock_print_stats(), so a named lock must never be
+   freed. */
+void
+adaptive_lock_init (struct adaptive_lock *al, const char *name)
+{
+  ASSERT (al != NULL);
+
+  lock_init (&al->lock);
+  if (name != NULL)
+    lock_set_name (&al->lock, name);
+  al->name = name;
+  al->spin_limit = ADAPTIVE_SPIN_LIMIT;
+  al->acquire_time = 0;
+  al->acquire_cnt = al->contend_cnt = 0;
+  al->spin_cnt = al->block_cnt = 0;
+  al->hold_ticks = al->max_hold_ticks = 0;
+
+  if (name != NULL)
+    {
+      enum intr_level old_level = intr_disable ();
+      list_push_back (&adaptive_locks, &al->elem);
+      intr_set_level (old_level);
+    }
+}
+
+/* Returns true if AL is held by a thread that is waiting on the
+   ready list, that is, one that will release AL as soon as it
+   gets the CPU back rather than after some slow event.  On a
+   uniprocessor this is the analogue of "the holder is running
+   on another CPU".
+
+   Returns false if the holder has lower priority than the
+   current thread.  Yielding donates no priority, so a scheduler
+   that picks by priority would just run us again instead of the
+   holder; sleeping in lock_acquire() at least lets it run. */
+static bool
+holder_is_ready (const struct adaptive_lock *al)
+{
+  enum intr_level old_level = intr_disable ();
+  struct thread *holder = al->lock.holder;
+  bool ready = (holder != NULL && holder->status == THREAD_READY
+                && holder->priority >= thread_current ()->priority);
+  intr_set_level (old_level);
+  return ready;
+}
+
+/* Records that the current thread has just acquired AL.  Called
+   only with AL held, so the statistics need no other protection.
+   CONTENDED is true if AL was found held, and SPUN is true if it
+   was then won by yielding rather than by sleeping. */
+static void
+adaptive_lock_acquired (struct adaptive_lock *al, bool contended, bool spun)
+{
+  al->acquire_cnt++;
+  if (contended)
+    {
+      al->contend_cnt++;
+      if (spun)
+        al->spin_cnt++;
+      else
+        al->block_cnt++;
+    }
+  al->acquire_time = timer_ticks ();
+}
+
+/* Acquires AL, sleeping until it becomes available if
+   necessary.  While AL is held by a thread that is ready to
+   run, yields to it up to AL's spin limit first, which avoids
+   putting the current thread on the wait list when the critical
+   section is short.  The same restrictions as lock_acquire()
+   apply. */
+void
+adaptive_lock_acquire (struct adaptive_lock *al)
+{
+  unsigned spins = 0;
+  bool contended = false;
+  bool acquired;
+
+  ASSERT (al != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!adaptive_lock_held_by_current_thread (al));
+
+  acquired = lock_try_acquire (&al->lock);
+  if (!acquired)
+    {
+      contended = true;
+      while (!acquired && spins < al->spin_limit && holder_is_ready (al))
+        {
+          spins++;
+          thread_yield ();
+          acquired = lock_try_acquire (&al->lock);
+        }
+
+      if (!acquired)
+        lock_acquire (&al->lock);
+    }
+  adaptive_lock_acquired (al, contended, contended && acquired);
+}
+
+/* Tries to acquire AL and returns true if successful or false
+   on failure, without yielding or sleeping. */
+bool
+adaptive_lock_try_acquire (struct adaptive_lock *al)
+{
+  ASSERT (al != NULL);
+
+  if (!lock_try_acquire (&al->lock))
+    return false;
+  adaptive_lock_acquired (al, false, false);
+  return true;
+}
+
+/* Releases AL, which must be owned by the current thread. */
+void
+adaptive_lock_release (struct adaptive_lock *al)
+{
+  int64_t held;
+
+  ASSERT (al != NULL);
+
+  held = timer_ticks () - al->acquire_time;
+  al->hold_ticks += held;
+  if (held > al->max_hold_ticks)
+    al->max_hold_ticks = held;
+  lock_release (&al->lock);
+}
+
+/* Returns true if the current thread holds AL, false
+   otherwise. */
+bool
+adaptive_lock_held_by_current_thread (const struct adaptive_lock *al)
+{
+  ASSERT (al != NULL);
+
+  return lock_held_by_current_thread (&al->lock);
+}
+
+/* Prints statistics for each named adaptive lock. */
+void
+adaptive_lock_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&adaptive_locks); e != list_end (&adaptive_locks);
+       e = list_next (e))
+    {
+      struct adaptive_lock *al = list_entry (e, struct adaptive_lock, elem);
+      printf ("Lock %s: %llu acquires, %llu contended "
+              "(%llu spun, %llu blocked), %lld ticks held, %lld max\n",
+              al->name, al->acquire_cnt, al->contend_cnt, al->spin_cnt,
+              al->block_cnt, al->hold_ticks, al->max_hold_ticks);
+    }
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem 
   {
@@ -353,3 +579,452 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes reader-writer lock RW as unheld. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  rw->readers = 0;
+  rw->writer = NULL;
+  list_init (&rw->read_waiters);
+  list_init (&rw->write_waiters);
+}
+
+/* Returns the highest priority among the threads in WAITERS,
+   which must not be empty. */
+static int
+max_waiter_priority (struct list *waiters)
+{
+  struct list_elem *e = list_max (waiters, thread_priority_cmp, NULL);
+  return list_entry (e, struct thread, elem)->priority;
+}
+
+/* Returns true if a new reader with priority PRIORITY may join
+   RW right away.  Interrupts must be off. */
+static bool
+rwlock_read_ok (struct rwlock *rw, int priority)
+{
+  return (rw->writer == NULL
+          && (list_empty (&rw->write_waiters)
+              || priority > max_waiter_priority (&rw->write_waiters)));
+}
+
+/* Hands RW, which must be entirely free, over to its waiters:
+   the highest-priority writer if there is one and no reader
+   outranks it, otherwise every reader that outranks all the
+   waiting writers.  Returns the highest priority among the
+   threads woken up, or PRI_MIN - 1 if none were.  Interrupts
+   must be off. */
+static int
+rwlock_wake_waiters (struct rwlock *rw)
+{
+  int writer_pri = PRI_MIN - 1;
+  int woken_pri = PRI_MIN - 1;
+
+  ASSERT (rw->readers == 0 && rw->writer == NULL);
+
+  if (!list_empty (&rw->write_waiters))
+    writer_pri = max_waiter_priority (&rw->write_waiters);
+
+  if (list_empty (&rw->read_waiters)
+      || (writer_pri >= PRI_MIN
+          && writer_pri >= max_waiter_priority (&rw->read_waiters)))
+    {
+      if (writer_pri >= PRI_MIN)
+        {
+          struct list_elem *e = list_max (&rw->write_waiters,
+                                          thread_priority_cmp, NULL);
+          list_remove (e);
+          rw->writer = list_entry (e, struct thread, elem);
+          thread_unblock (rw->writer);
+          woken_pri = writer_pri;
+        }
+    }
+  else
+    {
+      struct list_elem *e, *next;
+
+      for (e = list_begin (&rw->read_waiters);
+           e != list_end (&rw->read_waiters); e = next)
+        {
+          struct thread *t = list_entry (e, struct thread, elem);
+          next = list_next (e);
+          if (t->priority > writer_pri)
+            {
+              list_remove (e);
+              rw->readers++;
+              thread_unblock (t);
+              if (t->priority > woken_pri)
+                woken_pri = t->priority;
+            }
+        }
+    }
+  return woken_pri;
+}
+
+/* Yields the CPU if a thread of priority WOKEN_PRI was just
+   woken up and outranks the running thread. */
+static void
+rwlock_maybe_yield (int woken_pri)
+{
+  if (!intr_context () && woken_pri > thread_current ()->priority)
+    thread_yield ();
+}
+
+/* Acquires RW for reading, sleeping until that is possible.
+   The lock is handed over by the releasing thread, so there is
+   nothing to recheck on wakeup.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (rw->writer != cur);
+
+  old_level = intr_disable ();
+  if (rwlock_read_ok (rw, cur->priority))
+    rw->readers++;
+  else
+    {
+      list_push_back (&rw->read_waiters, &cur->elem);
+      thread_block ();
+    }
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for reading if that is possible without waiting.
+   Returns true if successful, false otherwise. */
+bool
+rwlock_try_acquire_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  success = rwlock_read_ok (rw, thread_current ()->priority);
+  if (success)
+    rw->readers++;
+  intr_set_level (old_level);
+
+  return success;
+}
+
+/* Releases a read hold on RW. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  int woken_pri = PRI_MIN - 1;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (rw->readers > 0);
+  if (--rw->readers == 0)
+    woken_pri = rwlock_wake_waiters (rw);
+  intr_set_level (old_level);
+
+  rwlock_maybe_yield (woken_pri);
+}
+
+/* Acquires RW for writing, sleeping until that is possible.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (rw->writer != cur);
+
+  old_level = intr_disable ();
+  if (rw->writer == NULL && rw->readers == 0)
+    rw->writer = cur;
+  else
+    {
+      list_push_back (&rw->write_waiters, &cur->elem);
+      thread_block ();
+    }
+  ASSERT (rw->writer == cur);
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for writing if that is possible without waiting.
+   Returns true if successful, false otherwise. */
+bool
+rwlock_try_acquire_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  success = rw->writer == NULL && rw->readers == 0;
+  if (success)
+    rw->writer = thread_current ();
+  intr_set_level (old_level);
+
+  return success;
+}
+
+/* Releases RW, which the current thread must hold for
+   writing. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  int woken_pri;
+
+  ASSERT (rw != NULL);
+  ASSERT (rwlock_held_for_write (rw));
+
+  old_level = intr_disable ();
+  rw->writer = NULL;
+  woken_pri = rwlock_wake_waiters (rw);
+  intr_set_level (old_level);
+
+  rwlock_maybe_yield (woken_pri);
+}
+
+/* Returns true if the current thread holds RW for writing. */
+bool
+rwlock_held_for_write (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return rw->writer == thread_current ();
+}
+
+/* Initializes sequence lock SL. */
+void
+seqlock_init (struct seqlock *sl)
+{
+  ASSERT (sl != NULL);
+
+  sl->seq = 0;
+}
+
+/* Slow path of seqlock_read_begin(), taken when a write to SL
+   is in progress.  On a uniprocessor the writer can only be a
+   thread we preempted, so rather than spinning, give it the
+   CPU until it finishes. */
+unsigned
+seqlock_read_begin_slow (const struct seqlock *sl)
+{
+  unsigned seq;
+
+  ASSERT (!intr_context ());
+
+  while ((seq = *(volatile const unsigned *) &sl->seq) & 1)
+    thread_yield ();
+  return seq;
+}
+
+#ifdef LOCK_PROFILE
+/* Maximum number of distinct lock classes.  Locks beyond this
+   are accounted to a shared overflow class. */
+#define LOCK_CLASS_CNT 64
+
+/* Number of top waiters remembered per lock class. */
+#define LOCK_TOP_WAITERS 3
+
+/* A thread that waited on a lock class. */
+struct lock_waiter
+  {
+    tid_t tid;                  /* Waiting thread, 0 if slot unused. */
+    char name[16];              /* Its name, copied at the time. */
+    unsigned cnt;               /* Number of contended acquisitions. */
+    int64_t wait_ticks;         /* Total ticks spent waiting. */
+  };
+
+/* Profile shared by all the locks with the same name. */
+struct lock_class
+  {
+    const char *name;                   /* Name or initialization site. */
+    unsigned long long acquire_cnt;     /* Acquisitions. */
+    unsigned long long contend_cnt;     /* Acquisitions that had to wait. */
+    int64_t wait_ticks;                 /* Total ticks spent waiting. */
+    int64_t max_wait_ticks;             /* Longest single wait. */
+    int64_t max_hold_ticks;             /* Longest single hold. */
+    struct lock_waiter waiters[LOCK_TOP_WAITERS]; /* Worst waiters. */
+  };
+
+static struct lock_class lock_classes[LOCK_CLASS_CNT];
+static size_t lock_class_cnt;
+static struct lock_class overflow_class = { .name = "(other)" };
+
+/* Returns the lock class named NAME, creating it if
+   necessary.  Once every class is in use, locks with new names
+   all share OVERFLOW_CLASS, which keeps its own name. */
+static struct lock_class *
+lock_class_lookup (const char *name)
+{
+  struct lock_class *c;
+  enum intr_level old_level = intr_disable ();
+
+  for (c = lock_classes; c < lock_classes + lock_class_cnt; c++)
+    if (!strcmp (c->name, name))
+      break;
+  if (c == lock_classes + lock_class_cnt)
+    {
+      if (lock_class_cnt < LOCK_CLASS_CNT)
+        {
+          lock_class_cnt++;
+          c->name = name;
+        }
+      else
+        c = &overflow_class;
+    }
+
+  intr_set_level (old_level);
+  return c;
+}
+
+/* Returns true if waiter A ranks worse than waiter B. */
+static bool
+waiter_worse (const struct lock_waiter *a, const struct lock_waiter *b)
+{
+  return (a->wait_ticks > b->wait_ticks
+          || (a->wait_ticks == b->wait_ticks && a->cnt > b->cnt));
+}
+
+/* Charges WAIT ticks of waiting on class C to thread T, keeping
+   C's waiters sorted worst first.  Interrupts must be off. */
+static void
+lock_class_add_waiter (struct lock_class *c, struct thread *t, int64_t wait)
+{
+  struct lock_waiter *w, *end = c->waiters + LOCK_TOP_WAITERS;
+
+  for (w = c->waiters; w < end; w++)
+    if (w->tid == t->tid)
+      break;
+  if (w == end)
+    {
+      /* Not yet ranked: displace the least bad waiter, if T can
+         outrank it. */
+      struct lock_waiter new = { .tid = t->tid, .cnt = 1,
+                                 .wait_ticks = wait };
+      w = end - 1;
+      if (w->tid != 0 && !waiter_worse (&new, w))
+        return;
+      *w = new;
+      strlcpy (w->name, t->name, sizeof w->name);
+    }
+  else
+    {
+      w->cnt++;
+      w->wait_ticks += wait;
+    }
+
+  /* Bubble the updated entry towards the front. */
+  for (; w > c->waiters && waiter_worse (w, w - 1); w--)
+    {
+      struct lock_waiter tmp = w[-1];
+      w[-1] = *w;
+      *w = tmp;
+    }
+}
+
+/* Accounts an acquisition of LOCK by the current thread, which
+   waited WAIT ticks for it if CONTENDED. */
+static void
+lock_profile_acquired (struct lock *lock, bool contended, int64_t wait)
+{
+  struct lock_class *c = lock->class;
+  enum intr_level old_level = intr_disable ();
+
+  c->acquire_cnt++;
+  if (contended)
+    {
+      c->contend_cnt++;
+      c->wait_ticks += wait;
+      if (wait > c->max_wait_ticks)
+        c->max_wait_ticks = wait;
+      lock_class_add_waiter (c, thread_current (), wait);
+    }
+  lock->acquire_time = timer_ticks ();
+
+  intr_set_level (old_level);
+}
+
+/* Accounts the release of LOCK by its holder. */
+static void
+lock_profile_released (struct lock *lock)
+{
+  struct lock_class *c = lock->class;
+  int64_t held = timer_ticks () - lock->acquire_time;
+
+  if (held > c->max_hold_ticks)
+    c->max_hold_ticks = held;
+}
+
+/* Orders lock classes from most to least contended, for
+   qsort(). */
+static int
+lock_class_compare (const void *a_, const void *b_)
+{
+  const struct lock_class *a = *(struct lock_class * const *) a_;
+  const struct lock_class *b = *(struct lock_class * const *) b_;
+
+  if (a->wait_ticks != b->wait_ticks)
+    return a->wait_ticks > b->wait_ticks ? -1 : 1;
+  if (a->contend_cnt != b->contend_cnt)
+    return a->contend_cnt > b->contend_cnt ? -1 : 1;
+  return a->acquire_cnt > b->acquire_cnt ? -1 : a->acquire_cnt < b->acquire_cnt;
+}
+
+/* Prints the lock contention profile, most contended lock
+   classes first. */
+void
+lock_print_stats (void)
+{
+  static struct lock_class *sorted[LOCK_CLASS_CNT + 1];
+  size_t cnt = 0;
+  size_t i;
+
+  for (i = 0; i < lock_class_cnt; i++)
+    if (lock_classes[i].acquire_cnt > 0)
+      sorted[cnt++] = &lock_classes[i];
+  if (overflow_class.acquire_cnt > 0)
+    sorted[cnt++] = &overflow_class;
+  qsort (sorted, cnt, sizeof *sorted, lock_class_compare);
+
+  printf ("Lock profile: %zu lock classes used\n", cnt);
+  printf ("  %-28s %9s %8s %6s %6s %6s  %s\n", "lock", "acquires",
+          "contend", "wait", "maxwt", "maxhd", "top waiters (waits/ticks)");
+  for (i = 0; i < cnt; i++)
+    {
+      struct lock_class *c = sorted[i];
+      const char *name = c->name;
+      int j;
+
+      /* Drop the "../../" that the build directory adds to
+         __FILE__. */
+      while (name[0] == '.' && name[1] == '.' && name[2] == '/')
+        name += 3;
+
+      printf ("  %-28s %9llu %8llu %6lld %6lld %6lld ", name,
+              c->acquire_cnt, c->contend_cnt, c->wait_ticks,
+              c->max_wait_ticks, c->max_hold_ticks);
+      for (j = 0; j < LOCK_TOP_WAITERS && c->waiters[j].tid != 0; j++)
+        printf (" %s(%u/%lld)", c->waiters[j].name, c->waiters[j].cnt,
+                c->waiters[j].wait_ticks);
+      printf ("\n");
+    }
+}
+#endif /* LOCK_PROFILE */
@@ -3,6 +3,7 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore 
@@ -22,6 +23,10 @@ struct lock
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+#ifdef LOCK_PROFILE
+    struct lock_class *class;   /* Profile this lock is accounted to. */
+    int64_t acquire_time;       /* Timer tick of last acquisition. */
+#endif
   };
 
 void lock_init (struct lock *);
@@ -29,6 +34,52 @@ void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+void lock_set_name (struct lock *, const char *name);
+
+#ifdef LOCK_PROFILE
+/* Lock contention profiling, enabled by building with
+   `make LOCK_PROFILE=1'.  Locks are accounted to a class named
+   after the source line that initialized them, so that, for
+   example, every thread's lock_child shares one entry, unless
+   lock_set_name() gives them a name of their own. */
+#define LOCK_STR(X) LOCK_STR_(X)
+#define LOCK_STR_(X) #X
+#define lock_init(LOCK) \
+        lock_init_named (LOCK, __FILE__ ":" LOCK_STR (__LINE__))
+void lock_init_named (struct lock *, const char *name);
+void lock_print_stats (void);
+#endif
+
+/* Adaptive lock.
+
+   A lock that, when it finds itself contended, yields the CPU a
+   bounded number of times while the holder is ready to run
+   before falling back to sleeping on the underlying lock.  Meant
+   for short critical sections, where the holder usually gets
+   out of the way within a time slice or two. */
+struct adaptive_lock
+  {
+    struct lock lock;           /* Underlying sleeping lock. */
+    const char *name;           /* Name for reporting, or null. */
+    unsigned spin_limit;        /* Max yields before sleeping. */
+    int64_t acquire_time;       /* Timer tick of last acquisition. */
+    struct list_elem elem;      /* Element in list of named locks. */
+
+    /* Statistics. */
+    unsigned long long acquire_cnt;   /* Total acquisitions. */
+    unsigned long long contend_cnt;   /* Acquisitions that found it held. */
+    unsigned long long spin_cnt;      /* Contended, won by yielding. */
+    unsigned long long block_cnt;     /* Contended, had to sleep. */
+    int64_t hold_ticks;               /* Total ticks held. */
+    int64_t max_hold_ticks;           /* Longest single hold. */
+  };
+
+void adaptive_lock_init (struct adaptive_lock *, const char *name);
+void adaptive_lock_acquire (struct adaptive_lock *);
+bool adaptive_lock_try_acquire (struct adaptive_lock *);
+void adaptive_lock_release (struct adaptive_lock *);
+bool adaptive_lock_held_by_current_thread (const struct adaptive_lock *);
+void adaptive_lock_print_stats (void);
 
 /* Condition variable. */
 struct condition 
@@ -48,4 +99,91 @@ void cond_broadcast (struct condition *, struct lock *);
    reference guide for more information.*/
 #define barrier() asm volatile ("" : : : "memory")
 
+/* Reader-writer lock.
+
+   Any number of readers may hold the lock at once, or a single
+   writer.  Waiting writers take precedence over newly arriving
+   readers, except that a reader whose priority is higher than
+   that of every waiting writer is not held back by them. */
+struct rwlock
+  {
+    int readers;                /* Number of readers holding lock. */
+    struct thread *writer;      /* Writer holding lock, or null. */
+    struct list read_waiters;   /* Threads waiting to read. */
+    struct list write_waiters;  /* Threads waiting to write. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+bool rwlock_try_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
+/* Sequence lock.
+
+   For tiny, hot, read-mostly data.  Readers take no lock at all:
+   they note the sequence number, read the data, and retry if a
+   writer ran in the meantime.  Writers must be serialized among
+   themselves, and a writer whose data is also read from an
+   interrupt handler must disable interrupts around the write,
+   because such a reader cannot wait for the writer to finish.
+
+   Read idiom:
+
+      unsigned seq;
+      do
+        {
+          seq = seqlock_read_begin (&sl);
+          ...copy out the protected data...
+        }
+      while (seqlock_read_retry (&sl, seq)); */
+struct seqlock
+  {
+    unsigned seq;               /* Odd while a write is in progress. */
+  };
+
+void seqlock_init (struct seqlock *);
+unsigned seqlock_read_begin_slow (const struct seqlock *);
+
+/* Starts a read of the data protected by SL and returns the
+   sequence number to pass to seqlock_read_retry(). */
+static inline unsigned
+seqlock_read_begin (const struct seqlock *sl)
+{
+  unsigned seq = *(volatile const unsigned *) &sl->seq;
+  if (seq & 1)
+    seq = seqlock_read_begin_slow (sl);
+  barrier ();
+  return seq;
+}
+
+/* Returns true if a writer modified the data protected by SL
+   since seqlock_read_begin() returned SEQ, in which case the
+   read must be retried. */
+static inline bool
+seqlock_read_retry (const struct seqlock *sl, unsigned seq)
+{
+  barrier ();
+  return *(volatile const unsigned *) &sl->seq != seq;
+}
+
+/* Starts a write to the data protected by SL. */
+static inline void
+seqlock_write_begin (struct seqlock *sl)
+{
+  sl->seq++;
+  barrier ();
+}
+
+/* Ends a write to the data protected by SL. */
+static inline void
+seqlock_write_end (struct seqlock *sl)
+{
+  barrier ();
+  sl->seq++;
+}
+
 #endif /* threads/synch.h */
@@ -5,12 +5,15 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -34,6 +37,11 @@ static struct thread *idle_thread;
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
+#ifdef USERPROG
+/* Cache of struct child. */
+static struct kmem_cache *child_cache;
+#endif
+
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
@@ -55,6 +63,34 @@ static long long user_ticks;    /* # of timer ticks in user programs. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
+/* Scheduler event trace.  The most recent SCHED_TRACE_CNT
+   wakeups and context switches are kept in a ring buffer and
+   dumped by the "sched-trace" kernel command-line action. */
+#define SCHED_TRACE_CNT 256
+
+/* Kinds of scheduler events. */
+enum sched_event_type
+  {
+    SCHED_WAKEUP,               /* Thread put on the run queue. */
+    SCHED_SWITCH                /* Thread switched in. */
+  };
+
+/* A scheduler event. */
+struct sched_event
+  {
+    int64_t tick;               /* When it happened. */
+    enum sched_event_type type; /* What happened. */
+    tid_t tid;                  /* Thread woken or switched in. */
+    tid_t prev_tid;             /* SCHED_SWITCH: thread switched out. */
+    enum thread_status prev_status; /* SCHED_SWITCH: its new status. */
+    int64_t latency;            /* SCHED_SWITCH: ticks spent ready. */
+  };
+
+static struct sched_event sched_trace[SCHED_TRACE_CNT];
+static unsigned long long sched_event_cnt; /* Events ever recorded. */
+static long long switch_cnt;    /* # of context switches. */
+static int64_t max_latency;     /* Longest run-queue wait seen. */
+
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
@@ -71,6 +107,10 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static struct sched_event *sched_trace_add (enum sched_event_type, tid_t);
+#ifdef USERPROG
+static void orphan_child (struct thread *, void *parent);
+#endif
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -110,6 +150,13 @@ thread_start (void)
 {
   /* Create the idle thread. */
   struct semaphore idle_started;
+
+#ifdef USERPROG
+  child_cache = kmem_cache_create ("child", sizeof (struct child), NULL);
+  if (child_cache == NULL)
+    PANIC ("thread_start: out of memory");
+#endif
+
   sema_init (&idle_started, 0);
   thread_create ("idle", PRI_MIN, idle, &idle_started);
 
@@ -133,10 +180,16 @@ thread_tick (void)
     idle_ticks++;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
-    user_ticks++;
+    {
+      user_ticks++;
+      t->user_ticks++;
+    }
 #endif
   else
-    kernel_ticks++;
+    {
+      kernel_ticks++;
+      t->kernel_ticks++;
+    }
 
   /* Enforce preemption. */
   if (++thread_ticks >= TIME_SLICE)
@@ -151,6 +204,50 @@ thread_print_stats (void)
           idle_ticks, kernel_ticks, user_ticks);
 }
 
+/* Prints the CPU accounting of thread T. */
+static void
+print_thread_stats (struct thread *t, void *aux UNUSED)
+{
+  printf ("  %5d %-16s %7lld %7lld %7lld %6lld %7u %7u\n",
+          t->tid, t->name, t->user_ticks, t->kernel_ticks, t->wait_ticks,
+          t->max_wait_ticks, t->voluntary_switches,
+          t->involuntary_switches);
+}
+
+/* Prints per-thread CPU accounting for every live thread,
+   followed by the most recent scheduler events. */
+void
+thread_print_sched_trace (void)
+{
+  static const char *status_names[] = {"running", "ready", "blocked",
+                                       "dying"};
+  unsigned long long first, i;
+  enum intr_level old_level;
+
+  printf ("Scheduler: %lld context switches, max run-queue wait %lld ticks\n",
+          switch_cnt, max_latency);
+  printf ("  %5s %-16s %7s %7s %7s %6s %7s %7s\n", "tid", "name", "user",
+          "kernel", "wait", "maxwt", "vol", "invol");
+  old_level = intr_disable ();
+  thread_foreach (print_thread_stats, NULL);
+  intr_set_level (old_level);
+
+  first = (sched_event_cnt > SCHED_TRACE_CNT
+           ? sched_event_cnt - SCHED_TRACE_CNT : 0);
+  printf ("Scheduler trace: last %llu of %llu events\n",
+          sched_event_cnt - first, sched_event_cnt);
+  for (i = first; i < sched_event_cnt; i++)
+    {
+      const struct sched_event *e = &sched_trace[i % SCHED_TRACE_CNT];
+      if (e->type == SCHED_WAKEUP)
+        printf ("  %8lld wakeup %d\n", e->tick, e->tid);
+      else
+        printf ("  %8lld switch %d (%s) -> %d, waited %lld\n", e->tick,
+                e->prev_tid, status_names[e->prev_status], e->tid,
+                e->latency);
+    }
+}
+
 /* Creates a new kernel thread named NAME with the given initial
    PRIORITY, which executes FUNCTION passing AUX as the argument,
    and adds it to the ready queue.  Returns the thread identifier
@@ -194,7 +291,7 @@ tid_t
      /* Establish parent-child relationship */
      t->parent_id = thread_current()->tid;
    
-     struct child *c = malloc(sizeof(*c));
+     struct child *c = kmem_cache_alloc(child_cache);
      if (c != NULL) {
        c->tid = tid;
        c->exit_error = t->exit_error;
@@ -261,6 +358,8 @@ thread_unblock (struct thread *t)
   ASSERT (t->status == THREAD_BLOCKED);
   list_push_back (&ready_list, &t->elem);
   t->status = THREAD_READY;
+  t->ready_tick = timer_ticks ();
+  sched_trace_add (SCHED_WAKEUP, t->tid);
   intr_set_level (old_level);
 }
 
@@ -312,10 +411,20 @@ thread_exit (void)
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
 
+#ifdef USERPROG
+    /* Our children may outlive us, so they must stop reporting
+       to us before our child records go away. */
+    enum intr_level old_level = intr_disable ();
+    thread_foreach (orphan_child, thread_current ());
+    intr_set_level (old_level);
+
     while(!list_empty(&thread_current()->child_proc)){
-      struct proc_file *f = list_entry (list_pop_front(&thread_current()->child_proc), struct child, elem);
-      free(f);
+      struct child *c = list_entry (list_pop_front(&thread_current()->child_proc), struct child, elem);
+      thread_free_child (c);
     }
+#endif
+
+  fpu_thread_exit (thread_current ());
 
   intr_disable ();
   list_remove (&thread_current()->allelem);
@@ -324,6 +433,24 @@ thread_exit (void)
   NOT_REACHED ();
 }
 
+#ifdef USERPROG
+/* Clears T's parent pointer if it is PARENT. */
+static void
+orphan_child (struct thread *t, void *parent)
+{
+  if (t->parent == parent)
+    t->parent = NULL;
+}
+
+/* Frees child record C, which must already be off its parent's
+   child_proc list. */
+void
+thread_free_child (struct child *c)
+{
+  kmem_cache_free (child_cache, c);
+}
+#endif
+
 /* Yields the CPU.  The current thread is not put to sleep and
    may be scheduled again immediately at the scheduler's whim. */
 void
@@ -338,6 +465,7 @@ thread_yield (void)
   if (cur != idle_thread) 
     list_push_back (&ready_list, &cur->elem);
   cur->status = THREAD_READY;
+  cur->ready_tick = timer_ticks ();
   schedule ();
   intr_set_level (old_level);
 }
@@ -426,6 +554,17 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
+      /* Nothing else is ready, so use the time to zero pages for
+         later PAL_ZERO requests.  palloc_prezero() does one page
+         at a time, so check in between whether an interrupt has
+         made some thread ready, and if so go back to run it. */
+      intr_enable ();
+      while (list_empty (&ready_list) && palloc_prezero ())
+        continue;
+      intr_disable ();
+      if (!list_empty (&ready_list))
+        continue;
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -492,9 +631,9 @@ static void
    
      /* General fields */
      list_init (&t->child_proc);
+     list_init (&t->mmaps);
+     t->heap_start = t->heap_break = NULL;
      t->parent = running_thread();
-     list_init (&t->files);
-     t->fd_count = 2;
      t->exit_error = -100;
      sema_init(&t->child_lock, 0);
      t->waitingon = 0;
@@ -567,6 +706,9 @@ thread_schedule_tail (struct thread *prev)
   /* Start new time slice. */
   thread_ticks = 0;
 
+  /* Make the FPU trap unless it already holds our state. */
+  fpu_switch (cur);
+
 #ifdef USERPROG
   /* Activate the new address space. */
   process_activate ();
@@ -603,7 +745,33 @@ schedule (void)
   ASSERT (is_thread (next));
 
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      struct sched_event *e = sched_trace_add (SCHED_SWITCH, next->tid);
+
+      /* A thread that is switched out while still runnable was
+         preempted or yielded; otherwise it gave up the CPU. */
+      if (cur->status == THREAD_READY)
+        cur->involuntary_switches++;
+      else
+        cur->voluntary_switches++;
+      switch_cnt++;
+
+      /* Charge NEXT for the time it spent on the run queue.  The
+         idle thread never goes through the run queue. */
+      e->prev_tid = cur->tid;
+      e->prev_status = cur->status;
+      if (next != idle_thread)
+        {
+          e->latency = e->tick - next->ready_tick;
+          next->wait_ticks += e->latency;
+          if (e->latency > next->max_wait_ticks)
+            next->max_wait_ticks = e->latency;
+          if (e->latency > max_latency)
+            max_latency = e->latency;
+        }
+
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
@@ -621,6 +789,25 @@ allocate_tid (void)
   return tid;
 }
 
+/* Appends an event of the given TYPE concerning thread TID to
+   the scheduler trace and returns it for the caller to fill in
+   any other details.  Interrupts must be off. */
+static struct sched_event *
+sched_trace_add (enum sched_event_type type, tid_t tid)
+{
+  struct sched_event *e = &sched_trace[sched_event_cnt++ % SCHED_TRACE_CNT];
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  e->tick = timer_ticks ();
+  e->type = type;
+  e->tid = tid;
+  e->prev_tid = 0;
+  e->prev_status = THREAD_RUNNING;
+  e->latency = 0;
+  return e;
+}
+
 /* Offset of `stack' member within `struct thread'.
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
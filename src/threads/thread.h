@@ -105,17 +105,34 @@ typedef int tid_t;
      struct list child_proc;
      struct thread* parent;
      struct file *self;
-     struct list files;
-     int fd_count;
+     struct file **fds;          /* Open files indexed by fd, or null. */
+     struct bitmap *fd_map;      /* Which fds are in use. */
  
      struct semaphore child_lock;
      int waitingon;
 
-     struct hash spt; // project3
+     struct spt *spt; // project3: 보조 페이지 테이블 (vm/page.c)
+     struct list mmaps;          /* Memory mappings (vm/mmap.c). */
+     int next_mapid;             /* Next mapid to hand out. */
+     void *heap_start;           /* Start of the heap (vm/heap.c). */
+     void *heap_break;           /* Current end of the heap. */
+
+     /* CPU accounting, owned by thread.c. */
+     int64_t user_ticks;               /* Ticks spent running user code. */
+     int64_t kernel_ticks;             /* Ticks spent in the kernel. */
+     int64_t ready_tick;               /* When last put on the run queue. */
+     int64_t wait_ticks;               /* Total time on the run queue. */
+     int64_t max_wait_ticks;           /* Longest single run-queue wait. */
+     unsigned voluntary_switches;      /* Blocked or exited. */
+     unsigned involuntary_switches;    /* Switched out while runnable. */
+
+     /* Owned by threads/fpu.c. */
+     void *fpu;                        /* Saved FPU state, or null. */
  
  #ifdef USERPROG
      /* Owned by userprog/process.c. */
      uint32_t *pagedir;
+     void *user_esp;             /* User stack pointer at system call entry. */
  
      /* === Hierarchical process structure === */
      tid_t parent_id;
@@ -147,6 +164,7 @@ void thread_start (void);
 
 void thread_tick (void);
 void thread_print_stats (void);
+void thread_print_sched_trace (void);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -160,6 +178,9 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+#ifdef USERPROG
+void thread_free_child (struct child *);
+#endif
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
@@ -15,6 +15,8 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "userprog/pagedir.h"
+#include "userprog/usermem.h"
+#include "userprog/syscall.h"
 #include "threads/palloc.h"
 
 
@@ -62,8 +64,6 @@ exception_init (void)
   intr_register_int (0, 0, INTR_ON, kill, "#DE Divide Error");
   intr_register_int (1, 0, INTR_ON, kill, "#DB Debug Exception");
   intr_register_int (6, 0, INTR_ON, kill, "#UD Invalid Opcode Exception");
-  intr_register_int (7, 0, INTR_ON, kill,
-                     "#NM Device Not Available Exception");
   intr_register_int (11, 0, INTR_ON, kill, "#NP Segment Not Present");
   intr_register_int (12, 0, INTR_ON, kill, "#SS Stack Fault Exception");
   intr_register_int (13, 0, INTR_ON, kill, "#GP General Protection Exception");
@@ -164,16 +164,19 @@ page_fault (struct intr_frame *f)
   struct thread *t = thread_current();
 
   if (not_present) {
-    struct page *p = page_lookup(&t->spt, fault_addr);
+    struct page *p = page_lookup(t->spt, fault_addr);
+
+    // 커널 모드 fault면 f->esp는 유저 스택이 아니므로 시스템 콜 진입 시 저장한 값을 사용
+    void *esp = user ? f->esp : t->user_esp;
 
     // 스택 확장 조건
     if (p == NULL &&
-        (uint32_t)fault_addr >= (uint32_t)f->esp - 32 &&
+        (uint32_t)fault_addr >= (uint32_t)esp - 32 &&
         is_user_vaddr(fault_addr) &&
-        (PHYS_BASE - pg_round_down(fault_addr)) <= (1 << 23)) {
+        (PHYS_BASE - pg_round_down(fault_addr)) <= STACK_MAX) {
 
       // 새 페이지 구조체 생성
-      p = malloc(sizeof(struct page));
+      p = page_alloc();
       if (!p) exit(-1);
 
       p->vaddr = pg_round_down(fault_addr);
@@ -181,13 +184,16 @@ page_fault (struct intr_frame *f)
       p->type = VM_ANON; // 스택도 anon으로 관리
       p->file = NULL;
 
-      if (!page_insert(&t->spt, p)) {
-        free(p);
+      if (!page_insert(t->spt, p)) {
+        page_free(p);
         exit(-1);
       }
     }
 
     if (p == NULL) {
+      // copy_from_user() 등에서 난 fault면 fixup 주소로 복귀
+      if (!user && usermem_fixup(f))
+        return;
       exit(-1);  // 기존과 동일
     }
 
@@ -195,15 +201,21 @@ page_fault (struct intr_frame *f)
     if (!frame) exit(-1);
 
     if (p->type == VM_FILE) {
-      file_seek(p->file, p->offset);
-      off_t read = file_read(p->file, frame->kaddr, p->read_bytes);
+      // 파일은 다른 스레드와 함께 쓰므로 파일 시스템 락 안에서 위치를 지정해 읽는다
+      acquire_filesys_lock();
+      off_t read = file_read_at(p->file, frame->kaddr, p->read_bytes, p->offset);
+      release_filesys_lock();
       if (read != (off_t)p->read_bytes) {
         frame_free(frame->kaddr);
         exit(-1);
       }
       memset(frame->kaddr + p->read_bytes, 0, p->zero_bytes);
     } else if (p->type == VM_ANON) {
-      swap_in(p, frame->kaddr);
+      // 한 번도 swap out되지 않은 anon 페이지(스택, 힙)는 0으로 채운다
+      if (p->swapped)
+        swap_in(p, frame->kaddr);
+      else
+        memset(frame->kaddr, 0, PGSIZE);
     }
 
     if (!install_page(p->vaddr, frame->kaddr, p->writable)) {
@@ -211,11 +223,16 @@ page_fault (struct intr_frame *f)
       exit(-1);
     }
 
+    // frame_allocate()가 고정해 둔 프레임을 매핑이 끝났으니 풀어 준다
     p->frame = frame;
-    frame->page = p;
+    frame_unpin(p);
     return;
   }
 
+  // 읽기 전용 페이지 쓰기 등: copy_to_user()에서 난 fault면 fixup 주소로 복귀
+  if (!user && usermem_fixup(f))
+    return;
+
   // 나머지는 기존대로 종료
   printf ("Page fault at %p: %s error %s page in %s context.\n",
           fault_addr,
@@ -7,6 +7,7 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -17,6 +18,7 @@
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "vm/mmap.h"
 #include "vm/page.h"
 #include <debug.h>
 
@@ -33,7 +35,7 @@ extern struct list open_files;
 tid_t process_execute(const char *file_name)
 {
   char *fn_copy;
-  char *f_name;
+  char *f_buf, *f_name;
   tid_t tid;
 
   fn_copy = palloc_get_page(0);
@@ -41,13 +43,21 @@ tid_t process_execute(const char *file_name)
     return TID_ERROR;
   strlcpy(fn_copy, file_name, PGSIZE);
 
+  /* strtok_r() may return a pointer into the middle of F_BUF,
+     or a null pointer, so keep F_BUF to free. */
   char *save_ptr;
-  f_name = malloc(strlen(file_name) + 1);
-  strlcpy(f_name, file_name, strlen(file_name) + 1);
-  f_name = strtok_r(f_name, " ", &save_ptr);
+  f_buf = malloc(strlen(file_name) + 1);
+  if (f_buf == NULL)
+  {
+    palloc_free_page(fn_copy);
+    return TID_ERROR;
+  }
+  strlcpy(f_buf, file_name, strlen(file_name) + 1);
+  f_name = strtok_r(f_buf, " ", &save_ptr);
 
-  tid = thread_create(f_name, PRI_DEFAULT, start_process, fn_copy);
-  free(f_name);
+  tid = thread_create(f_name != NULL ? f_name : "", PRI_DEFAULT,
+                      start_process, fn_copy);
+  free(f_buf);
 
   if (tid == TID_ERROR)
   {
@@ -129,6 +139,11 @@ start_process(void *file_name_)
   int argc = 0, i;
 
   char *copy = malloc(strlen(file_name) + 1);
+  if (copy == NULL)
+  {
+    palloc_free_page(file_name);
+    thread_exit();
+  }
   strlcpy(copy, file_name, strlen(file_name) + 1);
 
   for (token = strtok_r(copy, " ", &save_ptr); token != NULL;
@@ -137,7 +152,17 @@ start_process(void *file_name_)
     argc++;
   }
 
+  /* The strings in ARGV are copied onto the user stack by
+     argument_stack(), so every one of them, ARGV itself, and
+     COPY must be freed before jumping to user mode below:
+     nothing else will free them. */
   char **argv = malloc(argc * sizeof(char *));
+  if (argv == NULL)
+  {
+    free(copy);
+    palloc_free_page(file_name);
+    thread_exit();
+  }
   strlcpy(copy, file_name, strlen(file_name) + 1);
 
   for (token = strtok_r(copy, " ", &save_ptr), i = 0;
@@ -145,6 +170,15 @@ start_process(void *file_name_)
        token = strtok_r(NULL, " ", &save_ptr), i++)
   {
     argv[i] = malloc(strlen(token) + 1);
+    if (argv[i] == NULL)
+    {
+      while (i-- > 0)
+        free(argv[i]);
+      free(argv);
+      free(copy);
+      palloc_free_page(file_name);
+      thread_exit();
+    }
     strlcpy(argv[i], token, strlen(token) + 1);
   }
 
@@ -201,6 +235,7 @@ int process_wait(tid_t child_tid)
 
   int temp = ch->exit_error;
   list_remove(e1);
+  thread_free_child(ch);
 
   return temp;
 }
@@ -219,9 +254,15 @@ void process_exit(void)
 
   acquire_filesys_lock();
   file_close(thread_current()->self);
-  close_all_files(&thread_current()->files);
+  close_all_files();
+  mmap_destroy_all();
   release_filesys_lock();
 
+  /* Free the supplemental page table and the frames of its
+     pages while the page directory still maps them. */
+  supplemental_page_table_destroy(cur->spt);
+  cur->spt = NULL;
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -238,6 +279,30 @@ void process_exit(void)
     pagedir_activate(NULL);
     pagedir_destroy(pd);
   }
+
+  /* Let a waiting parent go on only now.  Waking it from exit()
+     let it print its own messages before our exit message, and
+     start new children while our memory was still in use.  With
+     interrupts off, the parent can't exit underneath us; if it
+     already has, thread_exit() cleared our parent pointer. */
+  enum intr_level old_level = intr_disable();
+  if (cur->parent != NULL)
+  {
+    struct list_elem *e;
+    for (e = list_begin(&cur->parent->child_proc); e != list_end(&cur->parent->child_proc);
+         e = list_next(e))
+    {
+      struct child *c = list_entry(e, struct child, elem);
+      if (c->tid == cur->tid)
+      {
+        c->exit_error = cur->exit_error;
+        c->has_been_waited = true;
+      }
+    }
+    if (cur->parent->waitingon == cur->tid)
+      sema_up(&cur->parent->child_lock);
+  }
+  intr_set_level(old_level);
 }
 
 /* Sets up the CPU for running user code in the current
@@ -335,6 +400,7 @@ bool load(const char *file_name, void (**eip)(void), void **esp)
   struct Elf32_Ehdr ehdr;
   struct file *file = NULL;
   off_t file_ofs;
+  uint32_t seg_end = 0;
   bool success = false;
   int i;
 
@@ -343,20 +409,26 @@ bool load(const char *file_name, void (**eip)(void), void **esp)
   t->pagedir = pagedir_create();
   if (t->pagedir == NULL)
     goto done;
+  t->spt = supplemental_page_table_create();
+  if (t->spt == NULL)
+    goto done;
   process_activate();
 
   /* Open executable file. */
 
-  char *fn_cp = malloc(strlen(file_name) + 1);
-  strlcpy(fn_cp, file_name, strlen(file_name) + 1);
+  /* Free FN_BUF, not FN_CP: strtok_r() may return a pointer
+     past leading spaces, or a null pointer. */
+  char *fn_buf = malloc(strlen(file_name) + 1);
+  if (fn_buf == NULL)
+    goto done;
+  strlcpy(fn_buf, file_name, strlen(file_name) + 1);
 
   char *save_ptr;
-  fn_cp = strtok_r(fn_cp, " ", &save_ptr);
+  char *fn_cp = strtok_r(fn_buf, " ", &save_ptr);
 
-  file = filesys_open(fn_cp);
+  file = fn_cp != NULL ? filesys_open(fn_cp) : NULL;
 
-  free(fn_cp);
-  // TODO : Free fn_cp
+  free(fn_buf);
 
   if (file == NULL)
   {
@@ -422,6 +494,8 @@ bool load(const char *file_name, void (**eip)(void), void **esp)
         if (!load_segment(file, file_page, (void *)mem_page,
                           read_bytes, zero_bytes, writable))
           goto done;
+        if (mem_page + read_bytes + zero_bytes > seg_end)
+          seg_end = mem_page + read_bytes + zero_bytes;
       }
       else
         goto done;
@@ -433,6 +507,9 @@ bool load(const char *file_name, void (**eip)(void), void **esp)
   if (!setup_stack(esp))
     goto done;
 
+  /* The heap starts empty just past the highest segment. */
+  t->heap_start = t->heap_break = (void *)seg_end;
+
   /* Start address. */
   *eip = (void (*)(void))ehdr.e_entry;
   success = true;
@@ -521,7 +598,7 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
     size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
     size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-    struct page *p = malloc(sizeof(struct page));
+    struct page *p = page_alloc();
     if (!p)
       return false;
 
@@ -534,9 +611,9 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
     p->read_bytes = page_read_bytes;
     p->zero_bytes = page_zero_bytes;
 
-    if (!page_insert(&thread_current()->spt, p))
+    if (!page_insert(thread_current()->spt, p))
     {
-      free(p);
+      page_free(p);
       return false;
     }
 
@@ -549,8 +626,8 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
   return true;
 }
 
-/* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
+/* Create a minimal stack by registering a zero-filled page at the
+   top of user virtual memory. */
 
 void argument_stack(const char *argv[], int argc, void **esp)
 {
@@ -595,19 +672,25 @@ void argument_stack(const char *argv[], int argc, void **esp)
 static bool
 setup_stack(void **esp)
 {
-  uint8_t *kpage;
-  bool success = false;
+  struct page *p = page_alloc();
+  if (!p)
+    return false;
+
+  /* Like the rest of the stack, the top page is anonymous and
+     faulted in through the frame table on first use, so that it
+     can be evicted and the load does not fail when the user pool
+     is full. */
+  p->vaddr = ((uint8_t *)PHYS_BASE) - PGSIZE;
+  p->writable = true;
+  p->type = VM_ANON;
 
-  kpage = palloc_get_page(PAL_USER | PAL_ZERO);
-  if (kpage != NULL)
+  if (!page_insert(thread_current()->spt, p))
   {
-    success = install_page(((uint8_t *)PHYS_BASE) - PGSIZE, kpage, true);
-    if (success)
-      *esp = PHYS_BASE;
-    else
-      palloc_free_page(kpage);
+    page_free(p);
+    return false;
   }
-  return success;
+  *esp = PHYS_BASE;
+  return true;
 }
 
 /* Adds a mapping from user virtual address UPAGE to kernel
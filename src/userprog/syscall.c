@@ -1,21 +1,27 @@
 #include "userprog/syscall.h"
+#include <bitmap.h>
+#include <iovec.h>
+#include <round.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/tss.h"
+#include "userprog/usermem.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "vm/heap.h"
+#include "vm/mmap.h"
 #include "list.h"
 #include "process.h"
 
-#define VALIDATE_PTR(ptr)  \
-if (!is_valid_ptr(ptr)) exit(-1);
-
 static void syscall_handler (struct intr_frame *);
-bool is_valid_ptr(const void*);
-struct file_descriptor *get_open_file(int fd);
-
-void acquire_filesys_lock(void);
-void release_filesys_lock(void);
+static void sysenter_handler (struct intr_frame *);
+struct file *get_open_file(int fd);
 
 void halt(void);
 void exit(int status);
@@ -30,116 +36,247 @@ int write (int fd, const void *buffer, unsigned size);
 void seek(int fd, unsigned position);
 unsigned tell(int fd);
 void close(int fd);
+int readv(int fd, const struct iovec *iov, int iovcnt);
+int writev(int fd, const struct iovec *iov, int iovcnt);
+int pread(int fd, void *buffer, unsigned size, unsigned position);
+int mmap(int fd, void *addr);
+void munmap(int mapid);
+int pwrite(int fd, const void *buffer, unsigned size, unsigned position);
 
 struct lock fs_lock;
 struct list open_files;
 
 extern bool running;
 
-struct file_descriptor {
-	int fd_num;
-	tid_t owner;
-	struct file* file_struct;
-	struct list_elem elem;
-};
+static char *copy_in_string(const char *ustr);
+
+/* Size of a process's fd table when it first opens a file,
+   counting stdin and stdout.  The table doubles when full. */
+#define FD_TABLE_INIT 16
 
 void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+  intr_register_int (SYSENTER_VEC, 0, INTR_ON, sysenter_handler, "sysenter");
+  tss_enable_sysenter ();
   lock_init(&fs_lock);
+  lock_set_name(&fs_lock, "fs");
   list_init(&open_files);
 }
 
+/* Unpacks the arguments of a system call from ARG[], calls
+   its implementation, and stores any result in F's EAX.
+
+   The arguments come from one of two places, according to how
+   the user program entered the kernel (see lib/user/syscall.c):
+
+   - `int $0x30' takes the system call number and arguments from
+     the user stack, number first, as in the original ABI.
+     syscall_handler() copies them in with copy_from_user(), so a
+     bad stack pointer kills the process.
+
+   - SYSENTER passes the number in EAX and the arguments in EBX,
+     ESI, EDI, and EBP.  ECX and EDX carry the user's stack
+     pointer and return address for sysenter.S. */
+typedef void syscall_func (struct intr_frame *f, const uint32_t arg[]);
+
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
+sys_halt(struct intr_frame *f UNUSED, const uint32_t arg[] UNUSED)
 {
-	int * p = f->esp;
-	VALIDATE_PTR(p);
-	int system_call = * p;
-	
-	switch (system_call)
+	halt();
+}
+
+static void
+sys_exit(struct intr_frame *f UNUSED, const uint32_t arg[])
+{
+	exit(arg[0]);
+}
+
+static void
+sys_exec(struct intr_frame *f, const uint32_t arg[])
+{
+	f->eax = exec((char *) arg[0]);
+}
+
+static void
+sys_wait(struct intr_frame *f, const uint32_t arg[])
+{
+	f->eax = wait(arg[0]);
+}
+
+static void
+sys_create(struct intr_frame *f, const uint32_t arg[])
+{
+	f->eax = create((const char *) arg[0], arg[1]);
+}
+
+static void
+sys_remove(struct intr_frame *f, const uint32_t arg[])
+{
+	f->eax = remove((const char *) arg[0]);
+}
+
+static void
+sys_open(struct intr_frame *f, const uint32_t arg[])
+{
+	f->eax = open((const char *) arg[0]);
+}
+
+static void
+sys_filesize(struct intr_frame *f, const uint32_t arg[])
+{
+	f->eax = filesize(arg[0]);
+}
+
+static void
+sys_read(struct intr_frame *f, const uint32_t arg[])
+{
+	f->eax = read(arg[0], (void *) arg[1], arg[2]);
+}
+
+static void
+sys_write(struct intr_frame *f, const uint32_t arg[])
+{
+	f->eax = write(arg[0], (const void *) arg[1], arg[2]);
+}
+
+static void
+sys_seek(struct intr_frame *f UNUSED, const uint32_t arg[])
+{
+	seek(arg[0], arg[1]);
+}
+
+static void
+sys_tell(struct intr_frame *f, const uint32_t arg[])
+{
+	f->eax = tell(arg[0]);
+}
+
+static void
+sys_close(struct intr_frame *f UNUSED, const uint32_t arg[])
+{
+	close(arg[0]);
+}
+
+static void
+sys_mmap(struct intr_frame *f, const uint32_t arg[])
+{
+	f->eax = mmap(arg[0], (void *) arg[1]);
+}
+
+static void
+sys_munmap(struct intr_frame *f UNUSED, const uint32_t arg[])
+{
+	munmap(arg[0]);
+}
+
+static void
+sys_readv(struct intr_frame *f, const uint32_t arg[])
+{
+	f->eax = readv(arg[0], (const struct iovec *) arg[1], arg[2]);
+}
+
+static void
+sys_writev(struct intr_frame *f, const uint32_t arg[])
+{
+	f->eax = writev(arg[0], (const struct iovec *) arg[1], arg[2]);
+}
+
+static void
+sys_pread(struct intr_frame *f, const uint32_t arg[])
+{
+	f->eax = pread(arg[0], (void *) arg[1], arg[2], arg[3]);
+}
+
+static void
+sys_pwrite(struct intr_frame *f, const uint32_t arg[])
+{
+	f->eax = pwrite(arg[0], (const void *) arg[1], arg[2], arg[3]);
+}
+
+static void
+sys_sbrk(struct intr_frame *f, const uint32_t arg[])
+{
+	f->eax = (uint32_t) heap_sbrk((intptr_t) arg[0]);
+}
+
+/* A system call. */
+struct syscall
 	{
-		case SYS_HALT:
-		halt();
-		break;
-
-		case SYS_EXIT:
-		VALIDATE_PTR(p+1);
-		exit(*(p+1));
-		break;
-
-		case SYS_EXEC:
-		VALIDATE_PTR(p+1);
-		VALIDATE_PTR(*(p+1));
-		f->eax = exec(*(p+1));
-		break;
-
-		case SYS_WAIT:
-		VALIDATE_PTR(p+1);
-		tid_t tid = *(p + 1);
-		f->eax = wait(tid);
-		break;
-
-		case SYS_CREATE:
-		VALIDATE_PTR(p+5);
-		VALIDATE_PTR(*(p+4));
-		f->eax = create(*(p+4), *(p+5));
-		break;
-
-		case SYS_REMOVE:
-		VALIDATE_PTR(p+1);
-		VALIDATE_PTR(*(p+1));
-		f->eax = remove(*(p+1));
-		break;
-
-		case SYS_OPEN:
-		VALIDATE_PTR(p+1);
-		VALIDATE_PTR(*(p+1));
-		f->eax = open(*(p + 1));
-		break;
-
-		case SYS_FILESIZE:
-		VALIDATE_PTR(p+1);
-		f->eax = filesize(*(p+1));
-		break;
-
-		case SYS_READ:
-		VALIDATE_PTR(p+7);
-		VALIDATE_PTR(*(p+6));
-		f->eax = read(*(p+5), *(p+6), *(p+7));
-		break;
-
-		case SYS_WRITE:
-		VALIDATE_PTR(p+7);
-		VALIDATE_PTR(*(p+6));
-
-		int fd = *(p+5);
-		const void *buffer = *(p+6);
-		unsigned size = *(p+7);
-	
-		f->eax = write(fd, buffer, size);
-		break;
-
-		case SYS_SEEK:
-		VALIDATE_PTR(p+5);
-		seek(*(p+4), *(p+5));
-		break;
-		
-		case SYS_TELL:
-		VALIDATE_PTR(p+1);
-		f->eax = tell(*(p+1));
-		break;
-		
-		case SYS_CLOSE:
-		VALIDATE_PTR(p+1);
-		close(*(p+1));
-		break;
-		
-		
-		default:
-		printf("Default %d\n",*p);
-	}
+		syscall_func *func;	/* Implementation. */
+		int arg_cnt;		/* Number of arguments. */
+	};
+
+/* System calls, indexed by SYS_* number. */
+static const struct syscall syscall_table[] =
+	{
+		[SYS_HALT] = { sys_halt, 0 },
+		[SYS_EXIT] = { sys_exit, 1 },
+		[SYS_EXEC] = { sys_exec, 1 },
+		[SYS_WAIT] = { sys_wait, 1 },
+		[SYS_CREATE] = { sys_create, 2 },
+		[SYS_REMOVE] = { sys_remove, 1 },
+		[SYS_OPEN] = { sys_open, 1 },
+		[SYS_FILESIZE] = { sys_filesize, 1 },
+		[SYS_READ] = { sys_read, 3 },
+		[SYS_WRITE] = { sys_write, 3 },
+		[SYS_SEEK] = { sys_seek, 2 },
+		[SYS_TELL] = { sys_tell, 1 },
+		[SYS_CLOSE] = { sys_close, 1 },
+		[SYS_MMAP] = { sys_mmap, 2 },
+		[SYS_MUNMAP] = { sys_munmap, 1 },
+		[SYS_READV] = { sys_readv, 3 },
+		[SYS_WRITEV] = { sys_writev, 3 },
+		[SYS_PREAD] = { sys_pread, 4 },
+		[SYS_PWRITE] = { sys_pwrite, 4 },
+		[SYS_SBRK] = { sys_sbrk, 1 },
+	};
+
+/* Returns the system call numbered NUMBER.  An unknown system
+   call number kills the process. */
+static const struct syscall *
+lookup_syscall(uint32_t number)
+{
+	if (number >= sizeof syscall_table / sizeof *syscall_table
+	    || syscall_table[number].func == NULL)
+		exit(-1);
+	return &syscall_table[number];
+}
+
+/* Handles `int $0x30': reads the system call number and its
+   arguments from the user stack and dispatches.  Each
+   implementation accesses user memory only through the
+   functions in usermem.c. */
+static void
+syscall_handler (struct intr_frame *f) 
+{
+	const struct syscall *sc;
+	uint32_t number, arg[4];
+
+	/* For page_fault(), which sees only the kernel's stack
+	   pointer if a user access from a system call faults. */
+	thread_current()->user_esp = f->esp;
+
+	if (!copy_from_user(&number, f->esp, sizeof number))
+		exit(-1);
+	sc = lookup_syscall(number);
+	if (!copy_from_user(arg, (uint32_t *) f->esp + 1,
+			    sc->arg_cnt * sizeof *arg))
+		exit(-1);
+	sc->func(f, arg);
+}
+
+/* Handles SYSENTER, which sysenter.S turns into a frame with
+   vector SYSENTER_VEC: the number and arguments are in
+   registers. */
+static void
+sysenter_handler (struct intr_frame *f)
+{
+	uint32_t arg[4] = { f->ebx, f->esi, f->edi, f->ebp };
+
+	thread_current()->user_esp = f->esp;
+	lookup_syscall(f->eax)->func(f, arg);
 }
 
 void
@@ -152,51 +289,52 @@ void
 exit(int status)
 {
 	//printf("Exit : %s %d %d\n",thread_current()->name, thread_current()->tid, status);
-	struct list_elem *e;
-	
-	for (e = list_begin (&thread_current()->parent->child_proc); e != list_end (&thread_current()->parent->child_proc);
-	e = list_next (e))
-	{
-		struct child *f = list_entry (e, struct child, elem);
-		if(f->tid == thread_current()->tid)
-		{
-			f->has_been_waited = true;
-			f->exit_error = status;
-		}
-	}
-	
-	
+	/* process_exit() reports STATUS to our parent and wakes it
+	   up once our resources are freed. */
 	thread_current()->exit_error = status;
 	
-	if(thread_current()->parent->waitingon == thread_current()->tid)
-	sema_up(&thread_current()->parent->child_lock);
-	
 	thread_exit();
 }
 
 int
 exec(char *file_name)
 {
+	char *cmd_line = copy_in_string(file_name);
+	int tid;
+
+	if (cmd_line == NULL)
+		return -1;
+
 	acquire_filesys_lock();
-	char * fn_cp = malloc (strlen(file_name)+1);
-	strlcpy(fn_cp, file_name, strlen(file_name)+1);
+	char * fn_buf = malloc (strlen(cmd_line)+1);
+	if (fn_buf == NULL)
+	{
+		release_filesys_lock();
+		palloc_free_page(cmd_line);
+		return -1;
+	}
+	strlcpy(fn_buf, cmd_line, strlen(cmd_line)+1);
 	
 	char * save_ptr;
-	fn_cp = strtok_r(fn_cp," ",&save_ptr);
+	char * fn_cp = strtok_r(fn_buf," ",&save_ptr);
 	
-	struct file* f = filesys_open (fn_cp);
+	struct file* f = fn_cp != NULL ? filesys_open (fn_cp) : NULL;
+	free(fn_buf);
 	
 	if(f==NULL)
 	{
 		release_filesys_lock();
-		return -1;
+		tid = -1;
 	}
 	else
 	{
 		file_close(f);
 		release_filesys_lock();
-		return process_execute(file_name);
+		tid = process_execute(cmd_line);
 	}
+
+	palloc_free_page(cmd_line);
+	return tid;
 }
 
 int
@@ -208,237 +346,529 @@ wait(tid_t tid)
 bool
 create(const char *file_name, unsigned initial_size)
 {
-	if (!is_valid_ptr(file_name)) {
-		exit(-1);
-	}
+	char *name = copy_in_string(file_name);
+	if (name == NULL)
+		return false;
 
 	acquire_filesys_lock();
-	bool success = filesys_create(file_name, initial_size);
+	bool success = filesys_create(name, initial_size);
 	release_filesys_lock();
 
+	palloc_free_page(name);
 	return success;
 }
 
 bool
 remove(const char *file_name)
 {
-	if (!is_valid_ptr(file_name)) {
-		exit(-1);
-	}
+	char *name = copy_in_string(file_name);
+	if (name == NULL)
+		return false;
   
 	acquire_filesys_lock();
-	bool success = filesys_remove(file_name);
+	bool success = filesys_remove(name);
 	release_filesys_lock();
   
+	palloc_free_page(name);
 	return success;
 }
 
+/* Grows T's fd table, every fd of which is in use, to twice its
+   size, creating it if T has none yet.  Returns true if
+   successful, false if out of memory. */
+static bool
+grow_fd_table(struct thread *t)
+{
+	size_t old_cnt = t->fd_map != NULL ? bitmap_size(t->fd_map) : 0;
+	size_t new_cnt = old_cnt != 0 ? old_cnt * 2 : FD_TABLE_INIT;
+	struct file **fds;
+	struct bitmap *fd_map;
+
+	fd_map = bitmap_create(new_cnt);
+	if (fd_map == NULL)
+		return false;
+	fds = realloc(t->fds, new_cnt * sizeof *fds);
+	if (fds == NULL) {
+		bitmap_destroy(fd_map);
+		return false;
+	}
+	memset(fds + old_cnt, 0, (new_cnt - old_cnt) * sizeof *fds);
+
+	/* Every old fd is in use; in a new table, only stdin and
+	   stdout are. */
+	bitmap_set_multiple(fd_map, 0, old_cnt != 0 ? old_cnt : 2, true);
+
+	bitmap_destroy(t->fd_map);
+	t->fds = fds;
+	t->fd_map = fd_map;
+	return true;
+}
+
+/* Installs FILE in the current process's fd table at the lowest
+   free fd and returns the fd, or -1 if out of memory. */
 static int
-allocate_fd(void)
+allocate_fd(struct file *file)
 {
-	return thread_current()->fd_count++;
+	struct thread *t = thread_current();
+	size_t fd = BITMAP_ERROR;
+
+	if (t->fd_map != NULL)
+		fd = bitmap_scan_and_flip(t->fd_map, 0, 1, false);
+	if (fd == BITMAP_ERROR) {
+		if (!grow_fd_table(t))
+			return -1;
+		fd = bitmap_scan_and_flip(t->fd_map, 0, 1, false);
+	}
+
+	t->fds[fd] = file;
+	return fd;
 }
 
 int
 open(const char *file_name)
 {
-    if (!is_valid_ptr(file_name)) {
-        exit(-1);
-    }
+    char *name = copy_in_string(file_name);
+    if (name == NULL)
+        return -1;
 
     acquire_filesys_lock();
-    struct file* fptr = filesys_open(file_name);
+    struct file* fptr = filesys_open(name);
     release_filesys_lock();
+    palloc_free_page(name);
 
     if (fptr == NULL)
         return -1;
 
-    struct file_descriptor *pfile = malloc(sizeof(*pfile));
-    if (!pfile)
-        return -1;
-
-    pfile->file_struct = fptr;
-    pfile->fd_num = allocate_fd();
-    pfile->owner = thread_current()->tid;
-    list_push_back(&thread_current()->files, &pfile->elem);
+    int fd = allocate_fd(fptr);
+    if (fd < 0) {
+        acquire_filesys_lock();
+        file_close(fptr);
+        release_filesys_lock();
+    }
 
-    return pfile->fd_num;
+    return fd;
 }
 
 int
 filesize(int fd)
 {
-	struct file_descriptor *fdesc = get_open_file(fd);
-	if (fdesc == NULL) {
+	struct file *file = get_open_file(fd);
+	if (file == NULL) {
 		return -1;
 	}
   
 	acquire_filesys_lock();
-	int size = file_length(fdesc->file_struct);
+	int size = file_length(file);
 	release_filesys_lock();
 	
 	return size;
 }
 
+/* Largest number of bytes of a user buffer that the system
+   calls below pin at once.  Bigger transfers go in pieces, so
+   that no process can pin enough frames to leave nothing for
+   frame_evict(). */
+#define PIN_CHUNK (64 * PGSIZE)
+
+/* Transfers LEN bytes between pinned user memory at BUF and
+   FILE, or the console if FILE is null, in the direction and
+   from the position described for transfer().  If FILE is not
+   null, the caller must hold fs_lock.  Returns the number of
+   bytes transferred. */
+static size_t
+transfer_pinned(struct file *file, uint8_t *buf, size_t len, off_t pos,
+		bool write)
+{
+	size_t n;
+
+	if (file == NULL) {
+		if (write) {
+			putbuf((const char *) buf, len);
+		} else {
+			for (n = 0; n < len; n++) {
+				buf[n] = input_getc();
+			}
+		}
+		return len;
+	}
+	if (pos >= 0) {
+		return (write
+			? file_write_at(file, buf, len, pos)
+			: file_read_at(file, buf, len, pos));
+	}
+	return write ? file_write(file, buf, len) : file_read(file, buf, len);
+}
+
+/* Transfers SIZE bytes between user BUFFER and FILE, or the
+   console if FILE is null: reads into BUFFER if WRITE is false,
+   writes from it if WRITE is true.  If POS is nonnegative, the
+   file transfer starts at byte POS and leaves FILE's position
+   alone.  Otherwise it uses and advances the current position.
+
+   The buffer is pinned at most PIN_CHUNK bytes at a time, and
+   each piece is transferred and unpinned before the next is
+   pinned.  While a piece is pinned, the file system copies
+   straight into or out of it, whole sectors without any
+   intermediate buffer, and no page fault or eviction can happen
+   while fs_lock is held.  Kills the process if the buffer is
+   not valid.  Returns the number of bytes transferred, which is
+   short only at end of file. */
+static int
+transfer(struct file *file, void *buffer, size_t size, off_t pos, bool write)
+{
+	uint8_t *buf = buffer;
+	size_t done = 0;
+
+	while (done < size) {
+		uint8_t *piece = buf + done;
+		size_t len = PIN_CHUNK - pg_ofs(piece);
+		size_t n;
+
+		if (len > size - done) {
+			len = size - done;
+		}
+		if (!usermem_pin(piece, len, !write)) {
+			exit(-1);
+		}
+
+		if (file != NULL) {
+			acquire_filesys_lock();
+		}
+		n = transfer_pinned(file, piece, len,
+				    pos >= 0 ? pos + (off_t) done : -1, write);
+		if (file != NULL) {
+			release_filesys_lock();
+		}
+
+		usermem_unpin(piece, len);
+		done += n;
+		if (n < len) {
+			break;
+		}
+	}
+	return done;
+}
+
+/* Reads SIZE bytes from FD into user BUFFER, as described for
+   transfer(). */
 int
 read(int fd, void *buffer, unsigned size)
 {
-	if (!is_valid_ptr(buffer)) {
-		exit(-1);
+	struct file *file = NULL;
+
+	if (fd != STDIN_FILENO) {
+		file = get_open_file(fd);
+		if (file == NULL) {
+			return -1;
+		}
 	}
-  
-	if (fd == 0) {  // STDIN
-		uint8_t *buf = buffer;
-		unsigned i;
-		for (i = 0; i < size; i++) {
-		buf[i] = input_getc();
+	return transfer(file, buffer, size, -1, false);
+}
+
+/* Writes SIZE bytes from user BUFFER to FD, as described for
+   transfer(). */
+int
+write (int fd, const void *buffer, unsigned size) 
+{
+	struct file *file = NULL;
+
+	if (fd == STDIN_FILENO) {
+		return -1;
+	}
+	if (fd != STDOUT_FILENO) {
+		file = get_open_file(fd);
+		if (file == NULL) {
+			return -1;
 		}
-		return size;
 	}
-  
-	struct file_descriptor *fdesc = get_open_file(fd);
-	if (fdesc == NULL) {
+	return transfer(file, (void *) buffer, size, -1, true);
+}
+
+/* Maps the file open as FD into memory starting at page-aligned
+   user address ADDR and returns a mapping id, or -1 if FD is not
+   an open file, the file is empty, or the mapping would overlap
+   existing pages or the stack.  Pages are read in on first
+   access and written back, if modified, when evicted or
+   unmapped.  The mapping stays valid after FD is closed. */
+int
+mmap(int fd, void *addr)
+{
+	struct file *file = get_open_file(fd);
+	int mapid = -1;
+
+	if (file == NULL) {
 		return -1;
 	}
-  
+
 	acquire_filesys_lock();
-	int bytes_read = file_read(fdesc->file_struct, buffer, size);
+	file = file_reopen(file);
+	if (file != NULL) {
+		mapid = mmap_create(file, addr, file_length(file));
+	}
 	release_filesys_lock();
-  
-	return bytes_read;
+
+	return mapid;
 }
 
-int
-write (int fd, const void *buffer, unsigned size) 
+/* Removes mapping MAPID, writing back its modified pages.  Does
+   nothing if MAPID is not a mapping of the current process. */
+void
+munmap(int mapid)
 {
-	int status = -1;
+	acquire_filesys_lock();
+	mmap_destroy(mapid);
+	release_filesys_lock();
+}
 
-	if (!is_valid_ptr(buffer)) {
-		exit(-1);
+/* Unpins the CNT buffers in BATCH. */
+static void
+unpin_batch(const struct iovec *batch, int cnt)
+{
+	int i;
+
+	for (i = 0; i < cnt; i++) {
+		usermem_unpin(batch[i].iov_base, batch[i].iov_len);
 	}
+}
 
-	acquire_filesys_lock();
+/* Reads from FD into the IOVCNT buffers described by the user
+   array UIOV, filling each in turn, if WRITE is false, or writes
+   those buffers to FD in turn if WRITE is true.  Returns the
+   total number of bytes transferred, which is short only if a
+   buffer could not be filled or written completely, or -1 if FD
+   is not open for the transfer or IOVCNT is out of range.
+
+   Looks up FD once for the whole vector.  Then pins as many
+   buffers as fit in PIN_CHUNK, splitting a buffer that doesn't
+   fit, and transfers the whole batch under a single acquisition
+   of fs_lock before unpinning it and going on to the next, so a
+   vector within PIN_CHUNK takes the lock exactly once. */
+static int
+transfer_vector(int fd, const struct iovec *uiov, int iovcnt, bool write)
+{
+	struct iovec iov[IOV_MAX];
+	struct iovec batch[IOV_MAX];
+	struct file *file = NULL;
+	size_t ofs = 0;
+	int total = 0;
+	int i = 0;
+
+	if (iovcnt < 0 || iovcnt > IOV_MAX) {
+		return -1;
+	}
+	if (!copy_from_user(iov, uiov, iovcnt * sizeof *iov)) {
+		exit(-1);
+	}
 
-	if (fd == STDIN_FILENO) {
-		lock_release(&fs_lock);
+	if (fd == (write ? STDIN_FILENO : STDOUT_FILENO)) {
 		return -1;
 	}
+	if (fd != STDIN_FILENO && fd != STDOUT_FILENO) {
+		file = get_open_file(fd);
+		if (file == NULL) {
+			return -1;
+		}
+	}
 
-	if (fd == STDOUT_FILENO) {
-		putbuf(buffer, size);
-		status = size;
-	} else {
-		struct file_descriptor *fd_struct = get_open_file(fd);
-		if (fd_struct != NULL) {
-			status = file_write(fd_struct->file_struct, buffer, size);
-		} else {
-			status = -1;
+	while (i < iovcnt) {
+		size_t pages = 0;
+		bool short_transfer = false;
+		int cnt = 0;
+		int k;
+
+		/* Pin the next batch, starting OFS bytes into buffer I.
+		   Each buffer contributes at most one piece, so BATCH
+		   can't overflow. */
+		while (i < iovcnt) {
+			uint8_t *base = (uint8_t *) iov[i].iov_base + ofs;
+			size_t len = iov[i].iov_len - ofs;
+			size_t room = PIN_CHUNK / PGSIZE - pages;
+
+			if (len == 0) {
+				i++;
+				ofs = 0;
+				continue;
+			}
+			if (room == 0) {
+				break;
+			}
+			if (len > room * PGSIZE - pg_ofs(base)) {
+				len = room * PGSIZE - pg_ofs(base);
+			}
+			if (!usermem_pin(base, len, !write)) {
+				unpin_batch(batch, cnt);
+				exit(-1);
+			}
+			batch[cnt].iov_base = base;
+			batch[cnt].iov_len = len;
+			cnt++;
+			pages += DIV_ROUND_UP(pg_ofs(base) + len, PGSIZE);
+
+			ofs += len;
+			if (ofs < iov[i].iov_len) {
+				break;
+			}
+			i++;
+			ofs = 0;
+		}
+
+		if (file != NULL) {
+			acquire_filesys_lock();
+		}
+		for (k = 0; k < cnt && !short_transfer; k++) {
+			size_t n = transfer_pinned(file, batch[k].iov_base,
+						   batch[k].iov_len, -1, write);
+
+			total += n;
+			short_transfer = n < batch[k].iov_len;
+		}
+		if (file != NULL) {
+			release_filesys_lock();
+		}
+		unpin_batch(batch, cnt);
+
+		if (short_transfer) {
+			break;
 		}
 	}
+	return total;
+}
 
-	release_filesys_lock();
-	return status;
+int
+readv(int fd, const struct iovec *iov, int iovcnt)
+{
+	return transfer_vector(fd, iov, iovcnt, false);
+}
+
+int
+writev(int fd, const struct iovec *iov, int iovcnt)
+{
+	return transfer_vector(fd, iov, iovcnt, true);
+}
+
+/* Reads SIZE bytes from FD, starting at byte POSITION, into user
+   BUFFER, without using or changing FD's current position.
+   Returns the number of bytes read, or -1 if FD is not an open
+   file. */
+int
+pread(int fd, void *buffer, unsigned size, unsigned position)
+{
+	struct file *file = get_open_file(fd);
+
+	if (file == NULL || (off_t) position < 0) {
+		return -1;
+	}
+	return transfer(file, buffer, size, position, false);
+}
+
+/* Writes SIZE bytes from user BUFFER to FD, starting at byte
+   POSITION, without using or changing FD's current position.
+   Returns the number of bytes written, or -1 if FD is not an
+   open file. */
+int
+pwrite(int fd, const void *buffer, unsigned size, unsigned position)
+{
+	struct file *file = get_open_file(fd);
+
+	if (file == NULL || (off_t) position < 0) {
+		return -1;
+	}
+	return transfer(file, (void *) buffer, size, position, true);
 }
 
 void
 seek(int fd, unsigned position)
 {
-	struct file_descriptor *fdesc = get_open_file(fd);
-	if (fdesc == NULL) {
+	struct file *file = get_open_file(fd);
+	if (file == NULL) {
 		return;
 	}
 
 	acquire_filesys_lock();
-	file_seek(fdesc->file_struct, position);
+	file_seek(file, position);
 	release_filesys_lock();
 }
 
 unsigned
 tell(int fd)
 {
-	struct file_descriptor *fdesc = get_open_file(fd);
-	if (fdesc == NULL) {
+	struct file *file = get_open_file(fd);
+	if (file == NULL) {
 		return -1;
 	}
 
 	acquire_filesys_lock();
-	unsigned pos = file_tell(fdesc->file_struct);
+	unsigned pos = file_tell(file);
 	release_filesys_lock();
 
 	return pos;
 }
 
-void
-close_open_file(int fd)
-{
-	struct list_elem *e;
-	for (e = list_begin(&thread_current()->files); e != list_end(&thread_current()->files); e = list_next(e)) {
-		struct file_descriptor *fd_struct = list_entry(e, struct file_descriptor, elem);
-		if (fd_struct->fd_num == fd) {
-			list_remove(e);
-			file_close(fd_struct->file_struct);
-			free(fd_struct);
-			return;
-		}
-	}
-}
-
 void
 close(int fd)
 {
+    struct thread *t = thread_current();
+
     acquire_filesys_lock();
-    struct file_descriptor *fd_struct = get_open_file(fd);
-    if (fd_struct != NULL && fd_struct->owner == thread_current()->tid) {
-        close_open_file(fd);
+    struct file *file = get_open_file(fd);
+    if (file != NULL) {
+        t->fds[fd] = NULL;
+        bitmap_reset(t->fd_map, fd);
+        file_close(file);
     }
     release_filesys_lock();
 }
 
+/* Closes every file the current process has open and frees its
+   fd table. */
 void
-close_all_files(struct list* files)
+close_all_files(void)
 {
-	struct list_elem *e;
-	while(!list_empty(files))
-	{
-		e = list_pop_front(files);
+	struct thread *t = thread_current();
+	size_t fd;
 
-		struct file_descriptor *f = list_entry (e, struct file_descriptor, elem);
-		file_close(f->file_struct);
-		list_remove(e);
-		free(f);
-	}
+	if (t->fd_map == NULL)
+		return;
+
+	for (fd = 0; fd < bitmap_size(t->fd_map); fd++)
+		if (t->fds[fd] != NULL)
+			file_close(t->fds[fd]);
+
+	free(t->fds);
+	bitmap_destroy(t->fd_map);
+	t->fds = NULL;
+	t->fd_map = NULL;
 }
 
-bool
-is_valid_ptr(const void *usr_ptr)
+/* Copies the null-terminated string at user address USTR into a
+   newly allocated page and returns it.  The caller must free the
+   page with palloc_free_page().  Kills the process if USTR is not
+   a valid user string no longer than a page.  Returns a null
+   pointer if out of memory. */
+static char *
+copy_in_string(const char *ustr)
 {
-	if (!is_user_vaddr(usr_ptr))
-	{
-		return false;
-	}
-	void *ptr = pagedir_get_page(thread_current()->pagedir, usr_ptr);
-	if (!ptr)
-	{
-		return false;
+	char *kstr = palloc_get_page(0);
+	if (kstr == NULL)
+		return NULL;
+
+	if (copy_string_from_user(kstr, ustr, PGSIZE) < 0) {
+		palloc_free_page(kstr);
+		exit(-1);
 	}
-	return true;
+	return kstr;
 }
 
-struct file_descriptor *
+/* Returns the file open as FD in the current process, or a null
+   pointer if FD is not open. */
+struct file *
 get_open_file(int fd)
 {
-    struct list_elem *e;
-    struct list *files = &thread_current()->files;
-
-    for (e = list_begin(files); e != list_end(files); e = list_next(e)) {
-        struct file_descriptor *fd_struct = list_entry(e, struct file_descriptor, elem);
-
-        if (fd_struct->fd_num == fd) {
-            return fd_struct;
-        }
-    }
+    struct thread *t = thread_current();
 
-    return NULL;
+    if (fd < 0 || t->fd_map == NULL || (size_t) fd >= bitmap_size(t->fd_map))
+        return NULL;
+    return t->fds[fd];
 }
 
 void
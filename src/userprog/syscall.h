@@ -2,5 +2,8 @@
 #define USERPROG_SYSCALL_H
 
 void syscall_init (void);
+void close_all_files (void);
+void acquire_filesys_lock (void);
+void release_filesys_lock (void);
 
 #endif /* userprog/syscall.h */
@@ -104,3 +104,52 @@ tss_update (void)
   ASSERT (tss != NULL);
   tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
 }
+
+/* SYSENTER model-specific registers.
+   See [IA32-v3a] 4.8.7 "Sysenter and Sysexit Instructions". */
+#define MSR_SYSENTER_CS  0x174  /* Kernel code selector. */
+#define MSR_SYSENTER_ESP 0x175  /* Kernel stack pointer. */
+#define MSR_SYSENTER_EIP 0x176  /* Kernel entry point. */
+
+/* CPUID.1 EDX bit for SYSENTER/SYSEXIT. */
+#define CPUID_SEP (1u << 11)
+
+static void
+wrmsr (uint32_t msr, uint32_t value)
+{
+  asm volatile ("wrmsr" : : "c" (msr), "a" (value), "d" (0));
+}
+
+/* Enables the SYSENTER/SYSEXIT system call path, if the CPU has
+   it, and returns true if successful.
+
+   SYSENTER does not consult the TSS, but loads ESP from a
+   model-specific register.  We point that register at the TSS's
+   esp0 member, so that sysenter_entry in sysenter.S can load the
+   current thread's kernel stack pointer from there, and thus
+   tss_update() keeps working for both paths. */
+bool
+tss_enable_sysenter (void)
+{
+  extern void sysenter_entry (void);
+  uint32_t eax, ebx, ecx, edx;
+  unsigned family, model, stepping;
+
+  ASSERT (tss != NULL);
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  if ((edx & CPUID_SEP) == 0)
+    return false;
+
+  /* The Pentium Pro reports SEP but does not implement it. */
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+  if (family == 6 && model < 3 && stepping < 3)
+    return false;
+
+  wrmsr (MSR_SYSENTER_CS, SEL_KCSEG);
+  wrmsr (MSR_SYSENTER_ESP, (uint32_t) &tss->esp0);
+  wrmsr (MSR_SYSENTER_EIP, (uint32_t) sysenter_entry);
+  return true;
+}
@@ -1,11 +1,21 @@
 #ifndef USERPROG_TSS_H
 #define USERPROG_TSS_H
 
+/* Vector number that sysenter_entry in sysenter.S stores in the
+   interrupt frame it builds, so that intr_handler() passes
+   SYSENTER system calls to their own handler.  Its IDT gate has
+   DPL 0, so user code cannot raise it with `int'. */
+#define SYSENTER_VEC 0x31
+
+#ifndef __ASSEMBLER__
+#include <stdbool.h>
 #include <stdint.h>
 
 struct tss;
 void tss_init (void);
 struct tss *tss_get (void);
 void tss_update (void);
+bool tss_enable_sysenter (void);
+#endif
 
 #endif /* userprog/tss.h */
@@ -0,0 +1,244 @@
+#include "userprog/usermem.h"
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+
+/* Access to user memory from the kernel.
+
+   Rather than checking each user page with pagedir_get_page()
+   before touching it, these routines check only that the user
+   range lies below PHYS_BASE and then access it directly.  If
+   the access faults, page_fault() first tries to page in the
+   user page as it would for a fault in user mode, so lazily
+   loaded, swapped out, and new stack pages all work.  If the
+   address is not part of the process's address space at all,
+   page_fault() looks up the faulting instruction in the fixup
+   table and resumes execution at the fixup address recorded for
+   it, where the routine reports failure to its caller.
+
+   Each entry in the fixup table is emitted alongside the
+   instruction it covers by FIXUP_ENTRY, into a section that
+   kernel.lds.S gathers between _start_fixup and _end_fixup. */
+
+/* Fixup table entry. */
+struct fixup
+  {
+    uintptr_t insn;             /* Address of an instruction that may fault. */
+    uintptr_t fixup;            /* Where to resume if it does. */
+  };
+
+extern const struct fixup _start_fixup[], _end_fixup[];
+
+/* Assembly that adds a fixup table entry for the instruction at
+   label INSN, resuming at label FIXUP. */
+#define FIXUP_ENTRY(INSN, FIXUP)                        \
+        ".pushsection __fixup_table, \"a\"\n\t"         \
+        ".long " INSN ", " FIXUP "\n\t"                 \
+        ".popsection\n\t"
+
+/* Returns true if the SIZE bytes starting at UADDR are all user
+   addresses. */
+static inline bool
+is_user_range (const void *uaddr, size_t size)
+{
+  return (uintptr_t) PHYS_BASE - (uintptr_t) uaddr >= size
+         && is_user_vaddr (uaddr);
+}
+
+/* Copies SIZE bytes from SRC to DST, a word at a time and then
+   a byte at a time.  Returns true if successful, false if the
+   copy faulted on an address that cannot be paged in. */
+static inline bool
+copy_with_fixup (void *dst, const void *src, size_t size)
+{
+  size_t words = size / 4;
+  size_t tail = size % 4;
+  int ok;
+
+  asm volatile ("movl $0, %[ok]\n"
+                "1:\trep movsl\n\t"
+                "movl %[tail], %%ecx\n"
+                "2:\trep movsb\n\t"
+                "movl $1, %[ok]\n"
+                "3:\n\t"
+                FIXUP_ENTRY ("1b", "3b")
+                FIXUP_ENTRY ("2b", "3b")
+                : [ok] "=&r" (ok), "+D" (dst), "+S" (src), "+c" (words)
+                : [tail] "r" (tail)
+                : "memory");
+  return ok;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Returns true if successful, false if any of the source
+   bytes is not a valid user address. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  return is_user_range (usrc, size) && copy_with_fixup (dst, usrc, size);
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST.  Returns true if successful, false if any of the
+   destination bytes is not a valid, writable user address. */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  return is_user_range (udst, size) && copy_with_fixup (udst, src, size);
+}
+
+/* Reads a byte at user virtual address UADDR, which must be
+   below PHYS_BASE.  Returns the byte value if successful, -1 if
+   UADDR is not a valid user address. */
+static inline int
+get_user (const uint8_t *uaddr)
+{
+  int result;
+
+  asm ("movl $-1, %0\n"
+       "1:\tmovzbl %1, %0\n"
+       "2:\n\t"
+       FIXUP_ENTRY ("1b", "2b")
+       : "=&r" (result) : "m" (*uaddr));
+  return result;
+}
+
+/* Copies the null-terminated string at user address USRC into
+   the SIZE-byte kernel buffer DST.  Returns the length of the
+   string, not including the null terminator, if successful.
+   Returns -1 if any byte of the string is not a valid user
+   address or if the string, with its null terminator, does not
+   fit in SIZE bytes. */
+int
+copy_string_from_user (char *dst, const char *usrc, size_t size)
+{
+  const uint8_t *u = (const uint8_t *) usrc;
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    {
+      int c;
+
+      if (!is_user_vaddr (u + i))
+        return -1;
+      c = get_user (u + i);
+      if (c < 0)
+        return -1;
+      dst[i] = c;
+      if (c == '\0')
+        return i;
+    }
+  return -1;
+}
+
+/* Pins user page UPAGE of the current process into memory,
+   paging it in first if necessary.  If WRITE is true, the page
+   must also be writable.  Returns true if successful, false if
+   UPAGE is not a valid (writable) user page. */
+static bool
+pin_page (const uint8_t *upage, bool write)
+{
+  struct thread *t = thread_current ();
+
+  for (;;)
+    {
+      struct page *p;
+      uint8_t byte;
+
+      /* Touch the page to fault it in. */
+      if (!copy_with_fixup (&byte, upage, 1))
+        return false;
+
+      /* Pages outside the supplemental page table, such as the
+         initial stack page, are never evicted. */
+      p = page_lookup (t->spt, upage);
+      if (p == NULL)
+        return true;
+
+      /* The page may have been evicted again since we touched
+         it, in which case we try again. */
+      if (frame_pin (p))
+        {
+          if (write && !p->writable)
+            {
+              frame_unpin (p);
+              return false;
+            }
+          return true;
+        }
+    }
+}
+
+/* Unpins the user pages from START up to but not including END,
+   both page-aligned. */
+static void
+unpin_pages (const uint8_t *start, const uint8_t *end)
+{
+  struct thread *t = thread_current ();
+  const uint8_t *upage;
+
+  for (upage = start; upage < end; upage += PGSIZE)
+    {
+      struct page *p = page_lookup (t->spt, upage);
+      if (p != NULL)
+        frame_unpin (p);
+    }
+}
+
+/* Pins every user page that contains any of the SIZE bytes at
+   UADDR, so that the kernel can access them directly, for
+   example from inside the file system with fs_lock held, without
+   faulting and without racing eviction.  If WRITE is true, the
+   pages must also be writable.  Returns true if successful,
+   false if any byte is not a valid (writable) user address.  On
+   success, the caller must call usermem_unpin() with the same
+   arguments when done. */
+bool
+usermem_pin (const void *uaddr, size_t size, bool write)
+{
+  const uint8_t *start = pg_round_down (uaddr);
+  const uint8_t *end = (const uint8_t *) uaddr + size;
+  const uint8_t *upage;
+
+  if (size == 0)
+    return true;
+  if (!is_user_range (uaddr, size))
+    return false;
+
+  for (upage = start; upage < end; upage += PGSIZE)
+    if (!pin_page (upage, write))
+      {
+        unpin_pages (start, upage);
+        return false;
+      }
+  return true;
+}
+
+/* Unpins the pages pinned by usermem_pin (UADDR, SIZE, ...). */
+void
+usermem_unpin (const void *uaddr, size_t size)
+{
+  if (size > 0)
+    unpin_pages (pg_round_down (uaddr),
+                 pg_round_up ((const uint8_t *) uaddr + size));
+}
+
+/* If F is a page fault raised in the kernel by one of the
+   accesses above, arranges for F to resume at its fixup address
+   and returns true.  Otherwise, returns false. */
+bool
+usermem_fixup (struct intr_frame *f)
+{
+  const struct fixup *p;
+
+  for (p = _start_fixup; p < _end_fixup; p++)
+    if (p->insn == (uintptr_t) f->eip)
+      {
+        f->eip = (void (*) (void)) p->fixup;
+        return true;
+      }
+  return false;
+}
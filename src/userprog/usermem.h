@@ -0,0 +1,16 @@
+#ifndef USERPROG_USERMEM_H
+#define USERPROG_USERMEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct intr_frame;
+
+bool copy_from_user (void *dst, const void *usrc, size_t size);
+bool copy_to_user (void *udst, const void *src, size_t size);
+int copy_string_from_user (char *dst, const char *usrc, size_t size);
+bool usermem_pin (const void *uaddr, size_t size, bool write);
+void usermem_unpin (const void *uaddr, size_t size);
+bool usermem_fixup (struct intr_frame *);
+
+#endif /* userprog/usermem.h */
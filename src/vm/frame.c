@@ -2,18 +2,23 @@
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
+#include "filesys/file.h"
 #include "vm/swap.h"   
 #include <hash.h>
 #include <debug.h>
+#include <stdio.h>
 
 static struct hash frame_table;  // 전역 프레임 테이블
-static struct lock frame_lock;   // 동시 접근 보호
+static struct adaptive_lock frame_lock;   // 동시 접근 보호
+static struct kmem_cache *frame_cache;    // struct frame 전용 캐시
 
 // 해시 함수
 static unsigned frame_hash(const struct hash_elem *e, void *aux UNUSED) {
     const struct frame *f = hash_entry(e, struct frame, hash_elem);
-    return hash_bytes(&f->kaddr, sizeof f->kaddr);
+    return hash_page(f->kaddr);
 }
 
 // 비교 함수
@@ -24,99 +29,60 @@ static bool frame_less(const struct hash_elem *a, const struct hash_elem *b, voi
 }
 
 // 테이블 초기화
-/* vm/frame.c */
-
-
-static struct list_elem *clock_ptr = NULL;
-
 void frame_init(void) {
+    hash_init(&frame_table, frame_hash, frame_less, NULL);
+    adaptive_lock_init(&frame_lock, "frame");
 
-    hash_init(&frame_hash, frame_hash_func, frame_less_func, NULL);
+    frame_cache = kmem_cache_create("frame", sizeof(struct frame), NULL);
+    if (frame_cache == NULL)
+        PANIC("frame_init: out of memory");
 
-    list_init(&frame_list);
-  
-    lock_init(&frame_lock);
- 
-    clock_ptr = NULL;
-    
     printf("Frame table initialized\n");
 }
 
-void frame_do_free(struct frame_table_entry *fte, bool free_memory) {
-    ASSERT(fte != NULL);
-    
-    lock_acquire(&frame_lock);
-
-    if (fte->upage != NULL && fte->owner != NULL) {
-
-        pagedir_clear_page(fte->owner->pagedir, fte->upage);
-    }
-
-    hash_delete(&frame_hash, &fte->hash_elem);
-    list_remove(&fte->list_elem);
-
-    if (clock_ptr == &fte->list_elem) {
-        clock_ptr = list_next(clock_ptr);
-        if (clock_ptr == list_end(&frame_list)) {
-            clock_ptr = list_begin(&frame_list);
-        }
-    }
-    
-    if (free_memory) {
-
-        palloc_free_page(fte->kpage);
-        free(fte);
-    } else {
-
-        fte->upage = NULL;
-        fte->owner = NULL;
-        fte->pinned = false;
-
-    }
-    
-    lock_release(&frame_lock);
-}
-
-
-void frame_set_pinned(struct frame_table_entry *fte, bool pinned) {
-    ASSERT(fte != NULL);
-    
-    lock_acquire(&frame_lock);
-
-    fte->pinned = pinned;
-    
-    lock_release(&frame_lock);
-}
-
+// PAGE를 올릴 프레임을 할당한다. 빈 프레임이 없으면 하나를 교체한다.
+// 반환되는 프레임은 고정되어 있어서, 호출자가 내용을 채우고 매핑한 뒤
+// page->frame을 설정하고 frame_unpin()할 때까지 교체되지 않는다.
 struct frame *frame_allocate(enum palloc_flags flags, struct page *page) {
-    lock_acquire(&frame_lock);
+    adaptive_lock_acquire(&frame_lock);
+
+    // PAGE가 아직 다른 스레드에 의해 교체되는 중이면 끝날 때까지 기다린다.
+    // 그래야 swap 슬롯이나 파일에 쓴 내용을 읽어 온다.
+    while (page->frame != NULL) {
+        adaptive_lock_release(&frame_lock);
+        thread_yield();
+        adaptive_lock_acquire(&frame_lock);
+    }
 
     void *kaddr = palloc_get_page(flags);
     if (!kaddr) {
         struct frame *evicted = frame_evict();
         ASSERT(evicted != NULL);
         kaddr = evicted->kaddr;
-        free(evicted);  // 이전 프레임 구조체는 메모리 해제
+        kmem_cache_free(frame_cache, evicted);  // 이전 프레임 구조체는 메모리 해제
     }
 
-    struct frame *f = malloc(sizeof(struct frame));
+    struct frame *f = kmem_cache_alloc(frame_cache);
     if (!f) {
         palloc_free_page(kaddr);
-        lock_release(&frame_lock);
+        adaptive_lock_release(&frame_lock);
         return NULL;
     }
 
     f->kaddr = kaddr;
     f->page = page;
+    f->owner = thread_current();
+    f->pinned = true;
+    f->evicting = false;
     hash_insert(&frame_table, &f->hash_elem);
 
-    lock_release(&frame_lock);
+    adaptive_lock_release(&frame_lock);
     return f;
 }
 
-// 프레임 해제
+// 프레임 해제. 아직 page에 연결되지 않은 프레임(frame_allocate() 직후)에 쓴다.
 void frame_free(void *kaddr) {
-    lock_acquire(&frame_lock);
+    adaptive_lock_acquire(&frame_lock);
 
     struct frame tmp;
     tmp.kaddr = kaddr;
@@ -125,12 +91,79 @@ void frame_free(void *kaddr) {
         struct frame *f = hash_entry(e, struct frame, hash_elem);
         hash_delete(&frame_table, &f->hash_elem);
         palloc_free_page(f->kaddr);
-        free(f);
+        kmem_cache_free(frame_cache, f);
     }
-    lock_release(&frame_lock);
+    adaptive_lock_release(&frame_lock);
 }
 
-struct frame *frame_evict(void) {
+// PAGE가 프레임에 있으면 PD에서 매핑을 지우고 프레임을 해제한 뒤 true 반환.
+// 교체 중인 프레임은 frame_evict()가 마저 정리하도록 page에서 떼어 놓기만 한다.
+// 프레임이 없으면 false. page->frame을 frame_lock 안에서 보므로 교체와 경쟁하지 않는다.
+bool frame_free_page(struct page *page, uint32_t *pd) {
+    bool had_frame = false;
+
+    adaptive_lock_acquire(&frame_lock);
+    struct frame *f = page->frame;
+    if (f != NULL) {
+        had_frame = true;
+        page->frame = NULL;
+        if (f->evicting) {
+            f->page = NULL;
+        } else {
+            if (pd != NULL)
+                pagedir_clear_page(pd, page->vaddr);  // pagedir_destroy의 이중 해제 방지
+            hash_delete(&frame_table, &f->hash_elem);
+            palloc_free_page(f->kaddr);
+            kmem_cache_free(frame_cache, f);
+        }
+    }
+    adaptive_lock_release(&frame_lock);
+    return had_frame;
+}
+
+// PAGE가 프레임에 올라와 있으면 그 프레임을 고정하고 true 반환.
+// 고정된 프레임은 frame_unpin() 전까지 교체되지 않으므로, 커널이 fault 없이
+// 직접 접근할 수 있다. 올라와 있지 않거나 교체 중이면 false.
+bool frame_pin(struct page *page) {
+    bool pinned = false;
+
+    adaptive_lock_acquire(&frame_lock);
+    if (page->frame != NULL && !page->frame->evicting) {
+        page->frame->pinned = true;
+        pinned = true;
+    }
+    adaptive_lock_release(&frame_lock);
+    return pinned;
+}
+
+// frame_pin()으로 고정한 PAGE의 프레임을 다시 교체 가능하게 한다.
+void frame_unpin(struct page *page) {
+    adaptive_lock_acquire(&frame_lock);
+    if (page->frame != NULL && !page->frame->evicting)
+        page->frame->pinned = false;
+    adaptive_lock_release(&frame_lock);
+}
+
+// PAGE가 프레임에 있고 PD에서 dirty면 프레임을 고정하고 커널 주소를 반환한다.
+// 호출자는 내용을 파일에 쓴 뒤 frame_unpin()한다. 아니면 NULL.
+// 교체 중인 mmap 페이지도 dirty로 보고 돌려준다: 교체하는 스레드는 파일
+// 시스템 락을 기다리는 중이고, 그동안 페이지가 해제되면 쓰기를 건너뛴다.
+// 호출자는 파일 시스템 락을 잡고 있어야 한다.
+void *frame_pin_dirty(struct page *page, uint32_t *pd) {
+    void *kaddr = NULL;
+
+    adaptive_lock_acquire(&frame_lock);
+    struct frame *f = page->frame;
+    if (f != NULL && (f->evicting || pagedir_is_dirty(pd, page->vaddr))) {
+        f->pinned = true;
+        kaddr = f->kaddr;
+    }
+    adaptive_lock_release(&frame_lock);
+    return kaddr;
+}
+
+// 교체할 프레임을 고른다. accessed 비트가 켜진 프레임은 비트를 끄고 한 번 봐준다.
+static struct frame *pick_victim(void) {
     struct hash_iterator i;
 
     // 2바퀴까지 순회 시도
@@ -142,28 +175,16 @@ struct frame *frame_evict(void) {
             struct frame *f = hash_entry(hash_cur(&i), struct frame, hash_elem);
             struct page *p = f->page;
 
-            if (p == NULL) continue;
+            if (p == NULL || f->pinned) continue;
+
+            // 다른 프로세스의 프레임일 수 있으므로 주인의 페이지 디렉터리를 본다
+            uint32_t *pd = f->owner->pagedir;
 
             // accessed 비트 확인
-            if (pagedir_is_accessed(thread_current()->pagedir, p->vaddr)) {
-                pagedir_set_accessed(thread_current()->pagedir, p->vaddr, false);
+            if (pagedir_is_accessed(pd, p->vaddr)) {
+                pagedir_set_accessed(pd, p->vaddr, false);
                 continue;
             }
-
-            // evict 조건 충족
-            if (p->type == VM_ANON) {
-                swap_out(p, f->kaddr);
-            } else if (p->type == VM_FILE) {
-                if (pagedir_is_dirty(thread_current()->pagedir, p->vaddr)) {
-                    // (선택 구현) write-back 필요 시 수행
-                }
-            }
-
-            pagedir_clear_page(thread_current()->pagedir, p->vaddr);
-            p->frame = NULL;
-            f->page = NULL;
-
-            hash_delete(&frame_table, &f->hash_elem);
             return f;
         }
     }
@@ -171,46 +192,68 @@ struct frame *frame_evict(void) {
     PANIC("No frame could be evicted after two passes!");
 }
 
-
-struct frame_table_entry *pick_frame_to_evict(void) {
-    ASSERT(lock_held_by_current_thread(&frame_lock));
-
-    if (list_empty(&frame_list)) {
-        return NULL;
+// 프레임 하나를 비워서 반환한다. frame_lock을 잡고 불러야 하며, 디스크에 쓰는
+// 동안에는 frame_lock을 놓았다가 다시 잡고 돌아온다.
+//
+// 희생 프레임은 먼저 매핑을 지우고 고정한 뒤(evicting) 락을 놓는다. 그동안
+// 주인이 fault를 내면 frame_allocate()에서 기다리고, 주인이 페이지를 해제하면
+// frame_free_page()가 프레임을 page에서 떼어 놓기만 한다. mmap 페이지는 파일
+// 시스템 락을 잡고 write-back한다. 락 순서는 파일 시스템 락 -> frame_lock이다.
+struct frame *frame_evict(void) {
+    struct frame *f = pick_victim();
+    struct page *p = f->page;
+    uint32_t *pd = f->owner->pagedir;
+    bool dirty = pagedir_is_dirty(pd, p->vaddr);
+
+    // 이제부터 주인이 접근하면 fault가 난다
+    pagedir_clear_page(pd, p->vaddr);
+
+    // 깨끗한 파일 페이지는 다음 fault 때 파일에서 다시 읽으면 된다
+    if (p->type == VM_FILE && !dirty) {
+        p->frame = NULL;
+        f->page = NULL;
+        hash_delete(&frame_table, &f->hash_elem);
+        return f;
     }
 
-    if (clock_ptr == NULL || clock_ptr == list_end(&frame_list)) {
-        clock_ptr = list_begin(&frame_list);
+    // mmap 페이지는 파일에 write-back하고, 수정된 실행 파일 데이터 페이지는
+    // 파일로 되돌릴 수 없으므로 anon 페이지처럼 swap으로 보낸다
+    bool to_file = p->type == VM_FILE && p->is_mmap;
+    struct file *file = p->file;
+    off_t offset = p->offset;
+    size_t bytes = p->read_bytes;
+    size_t slot = 0;
+
+    f->pinned = true;
+    f->evicting = true;
+    adaptive_lock_release(&frame_lock);
+
+    if (to_file) {
+        acquire_filesys_lock();
+        // munmap이나 종료로 페이지가 이미 해제됐으면 그쪽에서 write-back했다
+        adaptive_lock_acquire(&frame_lock);
+        bool detached = f->page == NULL;
+        adaptive_lock_release(&frame_lock);
+        if (!detached)
+            file_write_at(file, f->kaddr, bytes, offset);
+        release_filesys_lock();
+    } else {
+        slot = swap_out(f->kaddr);
     }
 
-    int max_iterations = list_size(&frame_list) * 2;  
-    
-    for (int i = 0; i < max_iterations; i++) {
-        struct frame_table_entry *fte = 
-            list_entry(clock_ptr, struct frame_table_entry, list_elem);
-        
-        clock_ptr = list_next(clock_ptr);
-        if (clock_ptr == list_end(&frame_list)) {
-            clock_ptr = list_begin(&frame_list);
-        }
-
-        if (fte->pinned) {
-            continue;  
-        }
-
-        bool accessed = false;
-        if (fte->upage != NULL && fte->owner != NULL) {
-            accessed = pagedir_is_accessed(fte->owner->pagedir, fte->upage);
-        }
-        
-        if (accessed) {
-            pagedir_set_accessed(fte->owner->pagedir, fte->upage, false);
-            continue;  
-        } else {
-            return fte;
+    adaptive_lock_acquire(&frame_lock);
+    if (f->page != NULL) {
+        if (!to_file) {
+            p->type = VM_ANON;
+            p->swap_slot = slot;
+            p->swapped = true;
         }
+        p->frame = NULL;
+    } else if (!to_file) {
+        swap_free(slot);   // 기다리는 동안 페이지가 해제됐다
     }
-
-    return NULL;
+    f->page = NULL;
+    f->evicting = false;
+    hash_delete(&frame_table, &f->hash_elem);
+    return f;
 }
-
@@ -3,27 +3,26 @@
 
 #include <hash.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "vm/page.h"
 #include "threads/palloc.h"
 
 struct frame {
     void *kaddr;           // 커널 가상주소 (실제 프레임의 시작 주소)
     struct page *page;     // 연결된 page
+    struct thread *owner;  // page를 가진 프로세스. 교체 때 이 페이지 디렉터리를 쓴다
+    bool pinned;           // true면 교체(evict) 대상에서 제외
+    bool evicting;         // frame_evict()가 frame_lock 없이 내보내는 중
     struct hash_elem hash_elem;
 };
 
-struct frame_table_entry {
-    void *kpage;                   
-    void *upage;                   
-    struct thread *owner;          
-    struct hash_elem hash_elem;    
-    struct list_elem list_elem;    
-    bool pinned;                   
-};
-
-void frame_table_init(void);
+void frame_init(void);
 struct frame *frame_allocate(enum palloc_flags flags, struct page *page);
 void frame_free(void *kaddr);
+bool frame_free_page(struct page *page, uint32_t *pd);
 struct frame *frame_evict(void);
+bool frame_pin(struct page *page);
+void frame_unpin(struct page *page);
+void *frame_pin_dirty(struct page *page, uint32_t *pd);
 
 #endif
@@ -0,0 +1,65 @@
+#include "vm/heap.h"
+#include "vm/page.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+
+// sbrk()가 실패했을 때 돌려주는 값
+#define SBRK_FAILED ((void *) -1)
+
+// 힙 페이지 하나를 UPAGE에 등록한다. 프레임은 처음 접근할 때
+// page_fault()가 0으로 채워서 붙인다. 이미 쓰이는 주소거나 메모리가
+// 부족하면 false.
+static bool
+heap_add_page(void *upage) {
+  struct thread *t = thread_current();
+  struct page *p;
+
+  if (pagedir_get_page(t->pagedir, upage) != NULL)
+    return false;
+
+  p = page_alloc();
+  if (p == NULL)
+    return false;
+  p->vaddr = upage;
+  p->writable = true;
+  p->type = VM_ANON;
+  if (!page_insert(t->spt, p)) {   // mmap 등이 이미 차지한 주소
+    page_free(p);
+    return false;
+  }
+  return true;
+}
+
+// 힙의 끝(break)을 INCREMENT 바이트 옮기고 이전 break를 반환한다.
+// 늘어난 페이지는 SPT에 anon으로만 등록되고, 줄어든 페이지는 프레임,
+// swap 슬롯과 함께 해제된다. 힙 시작보다 아래로 줄거나 스택 확장 영역 또는 다른
+// 매핑과 겹치게 늘면 아무것도 바꾸지 않고 (void *) -1.
+void *
+heap_sbrk(intptr_t increment) {
+  struct thread *t = thread_current();
+  uintptr_t old_break = (uintptr_t) t->heap_break;
+  uintptr_t new_break = old_break + increment;
+  uint8_t *old_top, *new_top, *upage;
+
+  if (increment > 0
+      ? new_break < old_break
+        || new_break > (uintptr_t) PHYS_BASE - STACK_MAX
+      : new_break > old_break
+        || new_break < (uintptr_t) t->heap_start)
+    return SBRK_FAILED;
+
+  old_top = pg_round_up((void *) old_break);
+  new_top = pg_round_up((void *) new_break);
+  if (new_top > old_top) {
+    for (upage = old_top; upage < new_top; upage += PGSIZE)
+      if (!heap_add_page(upage)) {
+        page_destroy_range(t->spt, old_top, upage);
+        return SBRK_FAILED;
+      }
+  } else if (new_top < old_top)
+    page_destroy_range(t->spt, new_top, old_top);
+
+  t->heap_break = (void *) new_break;
+  return (void *) old_break;
+}
@@ -0,0 +1,8 @@
+#ifndef VM_HEAP_H
+#define VM_HEAP_H
+
+#include <stdint.h>
+
+void *heap_sbrk(intptr_t increment);
+
+#endif
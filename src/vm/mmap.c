@@ -0,0 +1,156 @@
+#include "vm/mmap.h"
+#include <list.h>
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "filesys/file.h"
+#include "userprog/pagedir.h"
+
+// 메모리 매핑 하나. 프로세스의 mmaps 리스트에 들어간다.
+struct mmap_region {
+  int id;                   // mapid
+  struct file *file;        // 매핑 전용으로 다시 연 파일
+  void *addr;               // 시작 주소 (페이지 정렬)
+  size_t page_cnt;          // 페이지 수
+  struct list_elem elem;
+};
+
+// 매핑 영역의 끝 주소
+static void *
+region_end(const struct mmap_region *m) {
+  return (uint8_t *) m->addr + m->page_cnt * PGSIZE;
+}
+
+// ADDR부터 PAGE_CNT 페이지를 매핑할 수 있는지: 사용자 영역이고, 스택 확장
+// 영역과 겹치지 않고, 코드/데이터/다른 매핑(SPT)이나 초기 스택(페이지 디렉터리)
+// 어디에도 이미 쓰이지 않아야 한다.
+static bool
+range_is_free(const uint8_t *addr, size_t page_cnt) {
+  struct thread *t = thread_current();
+  size_t i;
+
+  if ((uintptr_t) addr + page_cnt * PGSIZE < (uintptr_t) addr
+      || (uintptr_t) addr + page_cnt * PGSIZE > (uintptr_t) PHYS_BASE - STACK_MAX)
+    return false;
+
+  for (i = 0; i < page_cnt; i++) {
+    const uint8_t *upage = addr + i * PGSIZE;
+    if (page_lookup(t->spt, upage) != NULL
+        || pagedir_get_page(t->pagedir, upage) != NULL)
+      return false;
+  }
+  return true;
+}
+
+// FILE의 처음 LENGTH 바이트를 ADDR에 매핑하고 mapid를 반환한다.
+// 페이지는 SPT에 VM_FILE로만 등록되고, 처음 접근할 때 page_fault()가 읽어 온다.
+// FILE은 매핑이 소유하며, 실패하면 닫는다. 실패하면 -1.
+// 호출자는 파일 시스템 락을 잡고 있어야 한다.
+int
+mmap_create(struct file *file, void *addr, off_t length) {
+  struct thread *t = thread_current();
+  size_t page_cnt = (length + PGSIZE - 1) / PGSIZE;
+  struct mmap_region *m;
+  size_t i;
+
+  if (addr == NULL || pg_ofs(addr) != 0 || length <= 0
+      || !range_is_free(addr, page_cnt))
+    goto fail;
+
+  m = malloc(sizeof *m);
+  if (m == NULL)
+    goto fail;
+
+  for (i = 0; i < page_cnt; i++) {
+    off_t ofs = i * PGSIZE;
+    size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+    struct page *p = page_alloc();
+
+    if (p == NULL) {
+      page_destroy_range(t->spt, addr, (uint8_t *) addr + i * PGSIZE);
+      free(m);
+      goto fail;
+    }
+    p->vaddr = (uint8_t *) addr + ofs;
+    p->writable = true;
+    p->type = VM_FILE;
+    p->is_mmap = true;
+    p->file = file;
+    p->offset = ofs;
+    p->read_bytes = read_bytes;
+    p->zero_bytes = PGSIZE - read_bytes;
+    // 자리는 range_is_free()로 확인했지만 페이지 테이블 할당은 실패할 수 있다
+    if (!page_insert(t->spt, p)) {
+      page_free(p);
+      page_destroy_range(t->spt, addr, (uint8_t *) addr + i * PGSIZE);
+      free(m);
+      goto fail;
+    }
+  }
+
+  m->id = t->next_mapid++;
+  m->file = file;
+  m->addr = addr;
+  m->page_cnt = page_cnt;
+  list_push_back(&t->mmaps, &m->elem);
+  return m->id;
+
+ fail:
+  file_close(file);
+  return -1;
+}
+
+// 프레임에 올라와 있고 dirty인 매핑 페이지를 파일에 다시 쓴다.
+// 교체된 페이지는 frame_evict()가 이미 썼다. 쓰는 동안 프레임을 고정해서
+// 다른 프로세스가 같은 프레임을 교체하지 못하게 한다.
+static void
+write_back(struct page *p, void *aux UNUSED) {
+  void *kaddr = frame_pin_dirty(p, thread_current()->pagedir);
+
+  if (kaddr != NULL) {
+    file_write_at(p->file, kaddr, p->read_bytes, p->offset);
+    frame_unpin(p);
+  }
+}
+
+// 매핑 M을 해제한다: dirty 페이지를 write-back하고, 페이지와 프레임을
+// 풀고, 파일을 닫는다.
+static void
+region_destroy(struct mmap_region *m) {
+  struct thread *t = thread_current();
+
+  page_apply_range(t->spt, m->addr, region_end(m), write_back, NULL);
+  page_destroy_range(t->spt, m->addr, region_end(m));
+  file_close(m->file);
+  list_remove(&m->elem);
+  free(m);
+}
+
+// MAPID 매핑을 해제한다. 그런 매핑이 없으면 false.
+// 호출자는 파일 시스템 락을 잡고 있어야 한다.
+bool
+mmap_destroy(int mapid) {
+  struct thread *t = thread_current();
+  struct list_elem *e;
+
+  for (e = list_begin(&t->mmaps); e != list_end(&t->mmaps); e = list_next(e)) {
+    struct mmap_region *m = list_entry(e, struct mmap_region, elem);
+    if (m->id == mapid) {
+      region_destroy(m);
+      return true;
+    }
+  }
+  return false;
+}
+
+// 프로세스 종료 시 모든 매핑을 해제한다.
+// 호출자는 파일 시스템 락을 잡고 있어야 한다.
+void
+mmap_destroy_all(void) {
+  struct thread *t = thread_current();
+
+  while (!list_empty(&t->mmaps))
+    region_destroy(list_entry(list_front(&t->mmaps), struct mmap_region, elem));
+}
@@ -0,0 +1,13 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <stdbool.h>
+#include "filesys/off_t.h"
+
+struct file;
+
+int mmap_create(struct file *file, void *addr, off_t length);
+bool mmap_destroy(int mapid);
+void mmap_destroy_all(void);
+
+#endif
@@ -1,11 +1,14 @@
 #include "vm/page.h"
 #include "vm/frame.h" 
+#include "vm/swap.h"
 #include "threads/vaddr.h"
 #include "threads/palloc.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
+#include "threads/pte.h"
 #include "userprog/pagedir.h"
-#include <hash.h>
+#include <string.h>
 
 
 bool install_page(void *upage, void *kpage, bool writable) {
@@ -14,56 +17,160 @@ bool install_page(void *upage, void *kpage, bool writable) {
             && pagedir_set_page(t->pagedir, upage, kpage, writable));
 }
 
-void page_destructor(struct hash_elem *e, void *aux);
-// 해시 함수
-static unsigned
-page_hash(const struct hash_elem *e, void *aux UNUSED) {
-  const struct page *p = hash_entry(e, struct page, hash_elem);
-  return hash_bytes(&p->vaddr, sizeof(p->vaddr));
+static struct kmem_cache *page_cache;  // struct page 전용 캐시
+
+// 페이지 캐시 초기화
+void
+page_init(void) {
+  page_cache = kmem_cache_create("page", sizeof(struct page), NULL);
+  if (page_cache == NULL)
+    PANIC("page_init: out of memory");
 }
 
-// 해시 비교 함수
-static bool
-page_less(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED) {
-  const struct page *pa = hash_entry(a, struct page, hash_elem);
-  const struct page *pb = hash_entry(b, struct page, hash_elem);
-  return pa->vaddr < pb->vaddr;
+// 페이지 구조체 할당. frame 등 채우지 않은 필드는 0/NULL로 시작한다
+struct page *
+page_alloc(void) {
+  struct page *p = kmem_cache_alloc(page_cache);
+  if (p != NULL)
+    memset(p, 0, sizeof *p);
+  return p;
 }
 
-// 페이지 테이블 초기화
+// 페이지 구조체 해제
 void
-supplemental_page_table_init(struct hash *spt) {
-  hash_init(spt, page_hash, page_less, NULL);
+page_free(struct page *page) {
+  kmem_cache_free(page_cache, page);
 }
 
-// 페이지 추가
+// 보조 페이지 테이블: 페이지 디렉터리 한 페이지 크기의 포인터 배열.
+// tables[pd_no(va)]가 NULL이 아니면 그 4MB 영역의 struct page 포인터
+// 1024개짜리 페이지 테이블이다.
+struct spt {
+  struct page **tables[1 << PDBITS];
+};
+
+// 페이지 테이블 하나에 담기는 엔트리 수
+#define SPT_ENTRY_CNT (1 << PTBITS)
+
+// 빈 보조 페이지 테이블 생성. 메모리가 부족하면 NULL
+struct spt *
+supplemental_page_table_create(void) {
+  return palloc_get_page(PAL_ZERO);
+}
+
+// 페이지 추가. 같은 주소의 페이지가 이미 있거나 메모리가 부족하면 false
 bool
-page_insert(struct hash *spt, struct page *page) {
-  return hash_insert(spt, &page->hash_elem) == NULL;
+page_insert(struct spt *spt, struct page *page) {
+  ASSERT(pg_ofs(page->vaddr) == 0);
+  ASSERT(is_user_vaddr(page->vaddr));
+
+  struct page ***table = &spt->tables[pd_no(page->vaddr)];
+  if (*table == NULL) {
+    *table = palloc_get_page(PAL_ZERO);
+    if (*table == NULL)
+      return false;
+  }
+
+  struct page **entry = &(*table)[pt_no(page->vaddr)];
+  if (*entry != NULL)
+    return false;
+  *entry = page;
+  return true;
 }
 
-// 페이지 조회
+// 페이지 조회: VADDR이 속한 페이지, 없으면 NULL
 struct page *
-page_lookup(struct hash *spt, void *vaddr) {
-  struct page p;
-  p.vaddr = pg_round_down(vaddr);  // 페이지 기준 주소로 정렬
-  struct hash_elem *e = hash_find(spt, &p.hash_elem);
-  if (e == NULL) return NULL;
-  return hash_entry(e, struct page, hash_elem);
+page_lookup(struct spt *spt, const void *vaddr) {
+  if (!is_user_vaddr(vaddr))
+    return NULL;
+
+  struct page **table = spt->tables[pd_no(vaddr)];
+  return table != NULL ? table[pt_no(vaddr)] : NULL;
 }
 
-// 전체 파괴
+// [START, END) 범위의 페이지마다 주소 순서대로 ACTION 호출.
+// 페이지 테이블이 없는 4MB 영역은 통째로 건너뛴다.
+// ACTION 안에서 SPT에 페이지를 추가하거나 제거하면 안 된다.
 void
-supplemental_page_table_destroy(struct hash *spt) {
-  hash_destroy(spt, page_destructor);
+page_apply_range(struct spt *spt, const void *start, const void *end,
+                 page_action_func *action, void *aux) {
+  uintptr_t va = (uintptr_t) pg_round_down(start);
+  uintptr_t limit = (uintptr_t) end < (uintptr_t) PHYS_BASE
+                    ? (uintptr_t) end : (uintptr_t) PHYS_BASE;
+
+  while (va < limit) {
+    struct page **table = spt->tables[pd_no((void *) va)];
+    uintptr_t table_end = (va & ~(uintptr_t) (PTSPAN - 1)) + PTSPAN;
+    if (table_end > limit)
+      table_end = limit;
+
+    if (table != NULL)
+      for (; va < table_end; va += PGSIZE) {
+        struct page *p = table[pt_no((void *) va)];
+        if (p != NULL)
+          action(p, aux);
+      }
+    va = table_end;
+  }
+}
+
+// 페이지 하나 해제: 매핑과 프레임, swap 슬롯을 풀고 구조체를 돌려준다
+static void
+page_destroy(struct page *p) {
+  // 프레임이 없을 때만 swap 슬롯을 본다: 교체 중이면 frame_evict()가 정리한다
+  if (!frame_free_page(p, thread_current()->pagedir) && p->swapped)
+    swap_free(p->swap_slot);
+  page_free(p);
+}
+
+// 페이지 테이블의 엔트리가 모두 비었는지
+static bool
+table_empty(struct page **table) {
+  size_t i;
+  for (i = 0; i < SPT_ENTRY_CNT; i++)
+    if (table[i] != NULL)
+      return false;
+  return true;
 }
 
-// 메모리 해제 함수
-void page_destructor(struct hash_elem *e, void *aux UNUSED) {
-  struct page *p = hash_entry(e, struct page, hash_elem);
-  if (p->frame != NULL) {
-    frame_free(p->frame->kaddr);  // 프레임 해제
+// [START, END) 범위의 페이지를 모두 SPT에서 빼고 해제한다.
+// 범위가 4MB 영역 전체를 덮거나 그 영역이 비게 되면 페이지 테이블도 해제한다.
+void
+page_destroy_range(struct spt *spt, const void *start, const void *end) {
+  uintptr_t va = (uintptr_t) pg_round_down(start);
+  uintptr_t limit = (uintptr_t) end < (uintptr_t) PHYS_BASE
+                    ? (uintptr_t) end : (uintptr_t) PHYS_BASE;
+
+  while (va < limit) {
+    struct page ***table = &spt->tables[pd_no((void *) va)];
+    uintptr_t table_start = va & ~(uintptr_t) (PTSPAN - 1);
+    uintptr_t table_end = table_start + PTSPAN;
+    bool whole = va == table_start && table_end <= limit;
+    if (table_end > limit)
+      table_end = limit;
+
+    if (*table != NULL) {
+      for (; va < table_end; va += PGSIZE) {
+        struct page **entry = &(*table)[pt_no((void *) va)];
+        if (*entry != NULL) {
+          page_destroy(*entry);
+          *entry = NULL;
+        }
+      }
+      if (whole || table_empty(*table)) {
+        palloc_free_page(*table);
+        *table = NULL;
+      }
+    }
+    va = table_end;
   }
-  free(p);  // 페이지 구조체 해제
 }
 
+// 전체 파괴: 사용자 영역 전체를 범위 해제한 뒤 디렉터리를 해제한다
+void
+supplemental_page_table_destroy(struct spt *spt) {
+  if (spt == NULL)
+    return;
+  page_destroy_range(spt, NULL, PHYS_BASE);
+  palloc_free_page(spt);
+}
@@ -1,7 +1,6 @@
 #ifndef VM_PAGE_H
 #define VM_PAGE_H
 
-#include <hash.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include "threads/thread.h"
@@ -9,6 +8,9 @@
 
 bool install_page(void *upage, void *kpage, bool writable);
 
+// 스택이 자랄 수 있는 최대 크기. 이 영역에는 mmap할 수 없다.
+#define STACK_MAX (1 << 23)
+
 enum page_type {
   VM_ANON,     // swap 영역
   VM_FILE,     // 파일 백업형
@@ -19,6 +21,7 @@ struct page {
   struct frame *frame;      // 연결된 프레임
   bool writable;            // 쓰기 가능 여부
   enum page_type type;      // 페이지 타입
+  bool is_mmap;             // mmap 페이지: 교체·해제 때 dirty면 파일에 다시 쓴다
 
   // file-backed 용
   struct file *file;
@@ -28,13 +31,29 @@ struct page {
 
   // swap 용
   size_t swap_slot;
-
-  struct hash_elem hash_elem;
+  bool swapped;             // swap에 내용이 있는지. 아니면 anon 페이지는 0으로 채운다
 };
 
-void supplemental_page_table_init(struct hash *spt);
-bool page_insert(struct hash *spt, struct page *page);
-struct page *page_lookup(struct hash *spt, void *vaddr);
-void supplemental_page_table_destroy(struct hash *spt);
+/* 보조 페이지 테이블(SPT).
+   x86 페이지 디렉터리와 같은 모양의 2단계 기수 트리로, 가상 페이지 번호의
+   상위 10비트로 디렉터리를, 하위 10비트로 페이지 테이블을 찾는다.
+   조회는 해시 없이 배열 두 번 참조로 끝나고, 4MB 영역마다 한 페이지의
+   포인터 배열만 쓰므로 연속된 큰 매핑도 작게 저장된다.
+   페이지 테이블은 처음 쓰일 때 할당된다. 정의는 vm/page.c에 있다. */
+struct spt;
+
+/* 범위 순회 때 각 페이지에 대해 호출되는 함수. */
+typedef void page_action_func(struct page *page, void *aux);
+
+void page_init(void);
+struct page *page_alloc(void);
+void page_free(struct page *page);
+struct spt *supplemental_page_table_create(void);
+bool page_insert(struct spt *spt, struct page *page);
+struct page *page_lookup(struct spt *spt, const void *vaddr);
+void page_apply_range(struct spt *spt, const void *start, const void *end,
+                      page_action_func *action, void *aux);
+void page_destroy_range(struct spt *spt, const void *start, const void *end);
+void supplemental_page_table_destroy(struct spt *spt);
 
 #endif
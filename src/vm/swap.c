@@ -7,24 +7,31 @@
 
 static struct block *swap_block;
 static struct bitmap *swap_bitmap;
-static struct lock swap_lock;
+static struct adaptive_lock swap_lock;
 
 #define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
 
-void vm_swap_init(void)
+void swap_init(void)
 {
+    adaptive_lock_init(&swap_lock, "swap");
+    // 스왑 디스크 없이 부팅할 수도 있다. 실제로 내보낼 때 패닉한다.
     swap_block = block_get_role(BLOCK_SWAP);
     if (!swap_block)
-        PANIC("No swap device!");
+        return;
     size_t swap_size = block_size(swap_block) / SECTORS_PER_PAGE;
-    swap_bitmap = bitmap_create(swap_size);
-    lock_init(&swap_lock);
+    /* 2단계 비트맵: 스왑이 거의 찼을 때도 빈 슬롯을 빠르게 찾는다.
+       수정은 swap_lock으로 직렬화된다. */
+    swap_bitmap = bitmap_create_two_level(swap_size);
+    if (!swap_bitmap)
+        PANIC("Swap bitmap creation failed!");
 }
 
-size_t vm_swap_out(struct page *page, void *kaddr)
+size_t swap_out(void *kaddr)
 {
-    lock_acquire(&swap_lock);
-    size_t swap_slot = bitmap_scan_and_flip(swap_bitmap, 0, 1, false);
+    if (!swap_block)
+        PANIC("No swap device!");
+    adaptive_lock_acquire(&swap_lock);
+    size_t swap_slot = bitmap_scan_and_flip_next(swap_bitmap, 1, false);
     if (swap_slot == BITMAP_ERROR)
         PANIC("No free swap slot!");
 
@@ -32,26 +39,26 @@ size_t vm_swap_out(struct page *page, void *kaddr)
     for (i = 0; i < SECTORS_PER_PAGE; ++i)
         block_write(swap_block, swap_slot * SECTORS_PER_PAGE + i, kaddr + i * BLOCK_SECTOR_SIZE);
 
-    lock_release(&swap_lock);
-    page->swap_slot = swap_slot;
+    adaptive_lock_release(&swap_lock);
     return swap_slot;
 }
 
-void vm_swap_in(struct page *page, void *kaddr)
+void swap_in(struct page *page, void *kaddr)
 {
-    lock_acquire(&swap_lock);
+    adaptive_lock_acquire(&swap_lock);
     size_t swap_slot = page->swap_slot;
     size_t i;
     for (i = 0; i < SECTORS_PER_PAGE; ++i)
         block_read(swap_block, swap_slot * SECTORS_PER_PAGE + i, kaddr + i * BLOCK_SECTOR_SIZE);
 
     bitmap_set(swap_bitmap, swap_slot, false);
-    lock_release(&swap_lock);
+    adaptive_lock_release(&swap_lock);
+    page->swapped = false;
 }
 
-void vm_swap_free(size_t swap_slot)
+void swap_free(size_t swap_slot)
 {
-    lock_acquire(&swap_lock);
+    adaptive_lock_acquire(&swap_lock);
     bitmap_set(swap_bitmap, swap_slot, false);
-    lock_release(&swap_lock);
+    adaptive_lock_release(&swap_lock);
 }
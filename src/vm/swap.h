@@ -5,7 +5,7 @@
 #include "vm/page.h"
 
 void swap_init(void);
-size_t swap_out(struct page *page, void *kaddr);
+size_t swap_out(void *kaddr);
 void swap_in(struct page *page, void *kaddr);
 void swap_free(size_t swap_slot);
 